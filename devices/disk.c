@@ -59,6 +59,7 @@ struct disk {
 
     long long read_cnt;  /* Number of sectors read. */
     long long write_cnt; /* Number of sectors written. */
+    long long write_req; /* Number of write commands issued. */
 };
 
 /* An ATA channel (aka controller).
@@ -84,7 +85,7 @@ static void reset_channel(struct channel *);
 static bool check_device_type(struct disk *);
 static void identify_ata_device(struct disk *);
 
-static void select_sector(struct disk *, disk_sector_t);
+static void select_sector(struct disk *, disk_sector_t, size_t cnt);
 static void issue_pio_command(struct channel *, uint8_t command);
 static void input_sector(struct channel *, void *);
 static void output_sector(struct channel *, const void *);
@@ -165,8 +166,8 @@ void disk_print_stats(void) {
         for (dev_no = 0; dev_no < 2; dev_no++) {
             struct disk *d = disk_get(chan_no, dev_no);
             if (d != NULL && d->is_ata)
-                printf("%s: %lld reads, %lld writes\n",
-                       d->name, d->read_cnt, d->write_cnt);
+                printf("%s: %lld reads, %lld writes in %lld requests\n",
+                       d->name, d->read_cnt, d->write_cnt, d->write_req);
         }
     }
 }
@@ -213,7 +214,7 @@ void disk_read(struct disk *d, disk_sector_t sec_no, void *buffer) {
 
     c = d->channel;
     lock_acquire(&c->lock);
-    select_sector(d, sec_no);
+    select_sector(d, sec_no, 1);
     issue_pio_command(c, CMD_READ_SECTOR_RETRY);
     sema_down(&c->completion_wait);
     if (!wait_while_busy(d))
@@ -223,6 +224,37 @@ void disk_read(struct disk *d, disk_sector_t sec_no, void *buffer) {
     lock_release(&c->lock);
 }
 
+/* Reads the CNT sectors starting at SEC_NO from disk D with a
+   single command, putting sector I into SECTORS[I], which must
+   have room for DISK_SECTOR_SIZE bytes.  CNT may be at most
+   DISK_MULTIPLE_MAX.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void disk_read_multiple(struct disk *d, disk_sector_t sec_no,
+                        void *const sectors[], size_t cnt) {
+    struct channel *c;
+    size_t i;
+
+    ASSERT(d != NULL);
+    ASSERT(sectors != NULL);
+    ASSERT(cnt > 0 && cnt <= DISK_MULTIPLE_MAX);
+
+    c = d->channel;
+    lock_acquire(&c->lock);
+    select_sector(d, sec_no, cnt);
+    issue_pio_command(c, CMD_READ_SECTOR_RETRY);
+    for (i = 0; i < cnt; i++) {
+        /* The disk interrupts once each sector is ready. */
+        sema_down(&c->completion_wait);
+        if (!wait_while_busy(d))
+            PANIC("%s: disk read failed, sector=%" PRDSNu, d->name,
+                  sec_no + (disk_sector_t)i);
+        input_sector(c, sectors[i]);
+    }
+    d->read_cnt += cnt;
+    lock_release(&c->lock);
+}
+
 /* Write sector SEC_NO to disk D from BUFFER, which must contain
    DISK_SECTOR_SIZE bytes.  Returns after the disk has
    acknowledged receiving the data.
@@ -236,13 +268,47 @@ void disk_write(struct disk *d, disk_sector_t sec_no, const void *buffer) {
 
     c = d->channel;
     lock_acquire(&c->lock);
-    select_sector(d, sec_no);
+    select_sector(d, sec_no, 1);
     issue_pio_command(c, CMD_WRITE_SECTOR_RETRY);
     if (!wait_while_busy(d))
         PANIC("%s: disk write failed, sector=%" PRDSNu, d->name, sec_no);
     output_sector(c, buffer);
     sema_down(&c->completion_wait);
     d->write_cnt++;
+    d->write_req++;
+    lock_release(&c->lock);
+}
+
+/* Writes the CNT sectors starting at SEC_NO to disk D with a single
+   command, taking sector I from SECTORS[I], which must contain
+   DISK_SECTOR_SIZE bytes.  CNT may be at most DISK_MULTIPLE_MAX.
+   Returns after the disk has acknowledged receiving all of them.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void disk_write_multiple(struct disk *d, disk_sector_t sec_no,
+                         const void *const sectors[], size_t cnt) {
+    struct channel *c;
+    size_t i;
+
+    ASSERT(d != NULL);
+    ASSERT(sectors != NULL);
+    ASSERT(cnt > 0 && cnt <= DISK_MULTIPLE_MAX);
+
+    c = d->channel;
+    lock_acquire(&c->lock);
+    select_sector(d, sec_no, cnt);
+    issue_pio_command(c, CMD_WRITE_SECTOR_RETRY);
+    for (i = 0; i < cnt; i++) {
+        /* The disk asks for each sector in turn and interrupts once it
+           has taken it. */
+        if (!wait_while_busy(d))
+            PANIC("%s: disk write failed, sector=%" PRDSNu, d->name,
+                  sec_no + (disk_sector_t)i);
+        output_sector(c, sectors[i]);
+        sema_down(&c->completion_wait);
+    }
+    d->write_cnt += cnt;
+    d->write_req++;
     lock_release(&c->lock);
 }
 
@@ -395,17 +461,19 @@ print_ata_string(char *string, size_t size) {
 }
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and the count CNT of sectors to transfer to the
+   disk's sector selection registers.  (We use LBA mode.) */
 static void
-select_sector(struct disk *d, disk_sector_t sec_no) {
+select_sector(struct disk *d, disk_sector_t sec_no, size_t cnt) {
     struct channel *c = d->channel;
 
     ASSERT(sec_no < d->capacity);
+    ASSERT(cnt <= d->capacity - sec_no);
     ASSERT(sec_no < (1UL << 28));
 
     select_device_wait(d);
-    outb(reg_nsect(c), 1);
+    /* A count of 0 means DISK_MULTIPLE_MAX. */
+    outb(reg_nsect(c), cnt == DISK_MULTIPLE_MAX ? 0 : cnt);
     outb(reg_lbal(c), sec_no);
     outb(reg_lbam(c), sec_no >> 8);
     outb(reg_lbah(c), (sec_no >> 16));
@@ -20,6 +20,42 @@
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* 8254 input frequency divided by TIMER_FREQ, rounded to nearest. */
+#define PIT_TICK_COUNT ((1193180 + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Most ticks a one-shot count may span.  One tick short of the 16-bit
+   counter's limit, so that a count that has run out and wrapped
+   around can still be told from one in progress.  That is 4 ticks at
+   100 Hz: the 8254 cannot let the CPU sleep longer than that, so
+   longer idle periods are covered by a chain of counts, and the CPU
+   still wakes briefly at the end of each. */
+#define TICKLESS_MAX (0xffff / PIT_TICK_COUNT - 1)
+
+/* Most ticks a chain of one-shot counts may span. */
+#define TICKLESS_CHAIN_MAX TIMER_FREQ
+
+/* If true, stop the periodic timer while the CPU is idle and program
+   a one-shot count up to the next sleeper's deadline instead.
+   Controlled by kernel command-line option "-tickless". */
+bool timer_tickless;
+
+/* One-shot state.  While oneshot_ticks is nonzero, the counter runs
+   down from oneshot_count and its interrupt ends oneshot_ticks
+   ticks, after oneshot_passed ticks that went by before the count
+   was programmed and have not been added to TICKS yet.  If the CPU
+   is still idle then, the next oneshot_more ticks are counted out
+   straight from the interrupt handler; oneshot_chained tells the
+   idle thread that it was woken by that and not by another
+   interrupt. */
+static int oneshot_ticks;
+static int oneshot_passed;
+static uint16_t oneshot_count;
+static int oneshot_more;
+static bool oneshot_chained;
+
+static long long oneshot_cnt;   /* # of one-shot counts programmed. */
+static long long skipped_ticks; /* # of ticks without an interrupt. */
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
@@ -28,19 +64,17 @@ static intr_handler_func timer_interrupt;
 static bool too_many_loops(unsigned loops);
 static void busy_wait(int64_t loops);
 static void real_time_sleep(int64_t num, int32_t denom);
+static void pit_set_periodic(void);
+static void pit_set_oneshot(uint16_t count);
+static uint16_t pit_read(void);
+static bool oneshot_start(int n);
+static int oneshot_elapsed(uint16_t remaining);
 
 /* Sets up the 8254 Programmable Interval Timer (PIT) to
    interrupt PIT_FREQ times per second, and registers the
    corresponding interrupt. */
 void timer_init(void) {
-    /* 8254 input frequency divided by TIMER_FREQ, rounded to
-       nearest. */
-    uint16_t count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
-
-    outb(0x43, 0x34); /* CW: counter 0, LSB then MSB, mode 2, binary. */
-    outb(0x40, count & 0xff);
-    outb(0x40, count >> 8);
-
+    pit_set_periodic();
     intr_register_ext(0x20, timer_interrupt, "8254 Timer");
 }
 
@@ -73,6 +107,10 @@ int64_t
 timer_ticks(void) {
     enum intr_level old_level = intr_disable();
     int64_t t = ticks;
+
+    /* Count the ticks a one-shot count has already run past. */
+    if (oneshot_ticks)
+        t += oneshot_passed + oneshot_elapsed(pit_read());
     intr_set_level(old_level);
     barrier();
     return t;
@@ -108,19 +146,160 @@ void timer_nsleep(int64_t ns) {
     real_time_sleep(ns, 1000 * 1000 * 1000);
 }
 
+/* Called by the idle thread, with interrupts off, just before it
+   halts.  Replaces the periodic timer by one-shot counts that end on
+   the tick boundary where the timing wheel next has work to do. */
+void timer_idle_enter(void) {
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    /* Whatever wakes the CPU from here on is news. */
+    oneshot_chained = false;
+
+    /* Already counting down, or a tick is pending in the PIC and
+       would be taken for the end of the count. */
+    if (oneshot_ticks)
+        return;
+    outb(0x20, 0x0a); /* OCW3: read IRR. */
+    if (inb(0x20) & 1)
+        return;
+
+    oneshot_start(thread_next_wakeup(TICKLESS_CHAIN_MAX));
+}
+
+/* Called by the idle thread after an interrupt woke it up.  If that
+   was not the timer, shortens the one-shot count to end at the next
+   tick boundary, so that whatever the interrupt made runnable gets a
+   regular tick again. */
+void timer_idle_exit(void) {
+    enum intr_level old_level = intr_disable();
+
+    if (oneshot_chained)
+        oneshot_chained = false;
+    else if (oneshot_ticks > 1 || oneshot_more > 0) {
+        uint16_t remaining = pit_read();
+        int passed = oneshot_elapsed(remaining);
+
+        oneshot_more = 0;
+        if (passed < oneshot_ticks) {
+            oneshot_passed += passed;
+            oneshot_ticks = 1;
+            oneshot_count = remaining - ((remaining - 1) / PIT_TICK_COUNT) * PIT_TICK_COUNT;
+            pit_set_oneshot(oneshot_count);
+        }
+    }
+    intr_set_level(old_level);
+}
+
 /* Prints timer statistics. */
 void timer_print_stats(void) {
     printf("Timer: %" PRId64 " ticks\n", timer_ticks());
+    if (timer_tickless)
+        printf("Timer: %lld ticks skipped in %lld one-shot counts\n",
+               skipped_ticks, oneshot_cnt);
 }
 
 /* Timer interrupt handler. */
 static void
 timer_interrupt(struct intr_frame *args UNUSED) {
+    if (oneshot_ticks) {
+        /* End of a one-shot count: every tick but the last went by
+           idle without an interrupt. */
+        int skipped = oneshot_passed + oneshot_ticks - 1;
+        int more = oneshot_more;
+
+        oneshot_ticks = 0;
+        oneshot_passed = 0;
+        oneshot_more = 0;
+        pit_set_periodic();
+        skipped_ticks += skipped;
+        while (skipped-- > 0) {
+            ticks++;
+            thread_tick_idle();
+        }
+
+        /* Nothing is due before the end of the chain, and nobody but
+           the idle thread has run: so did this tick, and the wheel can
+           wait until then. */
+        if (more > 0 && thread_idle_alone()) {
+            ticks++;
+            skipped_ticks++;
+            thread_tick_idle();
+            oneshot_chained = oneshot_start(more);
+            return;
+        }
+    }
     ticks++;
     thread_tick();
     thread_awake(ticks);
 }
 
+/* Programs counter 0 to interrupt TIMER_FREQ times per second. */
+static void
+pit_set_periodic(void) {
+    outb(0x43, 0x34); /* CW: counter 0, LSB then MSB, mode 2, binary. */
+    outb(0x40, PIT_TICK_COUNT & 0xff);
+    outb(0x40, PIT_TICK_COUNT >> 8);
+}
+
+/* Programs counter 0 to interrupt once, COUNT input clocks from now. */
+static void
+pit_set_oneshot(uint16_t count) {
+    outb(0x43, 0x30); /* CW: counter 0, LSB then MSB, mode 0, binary. */
+    outb(0x40, count & 0xff);
+    outb(0x40, count >> 8);
+}
+
+/* Programs a one-shot count that ends N ticks from now, keeping the
+   current tick's phase, and leaves whatever lies beyond TICKLESS_MAX
+   to further counts.  Must be called in periodic mode.  Returns
+   false, leaving the timer periodic, if N is too short to be worth
+   it or the phase cannot be read. */
+static bool
+oneshot_start(int n) {
+    uint16_t remaining;
+    int seg = n < TICKLESS_MAX ? n : TICKLESS_MAX;
+
+    if (n <= 1)
+        return false;
+
+    /* Count out the rest of this period, then SEG - 1 whole ones. */
+    remaining = pit_read();
+    if (remaining == 0 || remaining > PIT_TICK_COUNT)
+        return false;
+    oneshot_ticks = seg;
+    oneshot_passed = 0;
+    oneshot_more = n - seg;
+    oneshot_count = remaining + (seg - 1) * PIT_TICK_COUNT;
+    pit_set_oneshot(oneshot_count);
+    oneshot_cnt++;
+    return true;
+}
+
+/* Returns the current value of counter 0. */
+static uint16_t
+pit_read(void) {
+    uint8_t lo, hi;
+
+    outb(0x43, 0x00); /* CW: latch counter 0. */
+    lo = inb(0x40);
+    hi = inb(0x40);
+    return lo | (hi << 8);
+}
+
+/* Returns how many tick boundaries the one-shot count has crossed,
+   given the REMAINING value of the counter.  The last boundary is
+   its end. */
+static int
+oneshot_elapsed(uint16_t remaining) {
+    int left;
+
+    /* Ran out and wrapped around; the interrupt is pending. */
+    if (remaining == 0 || remaining > oneshot_count)
+        return oneshot_ticks;
+    left = DIV_ROUND_UP(remaining, PIT_TICK_COUNT);
+    return oneshot_ticks - left;
+}
+
 /* Returns true if LOOPS iterations waits for more than one timer
    tick, otherwise false. */
 static bool
@@ -108,6 +108,17 @@ off_t file_write_at(struct file *file, const void *buffer, off_t size,
     return inode_write_at(file->inode, buffer, size, file_ofs);
 }
 
+/* Writes SIZE bytes into FILE at FILE_OFS, which must be
+ * page-aligned, taking them from PAGES, PGSIZE bytes from each
+ * page in turn, with as few disk requests as possible.
+ * Returns the number of bytes actually written, which may be less
+ * than SIZE if end of file is reached.
+ * The file's current position is unaffected. */
+off_t file_write_pages(struct file *file, void *const pages[], off_t size,
+                       off_t file_ofs) {
+    return inode_write_pages(file->inode, pages, size, file_ofs);
+}
+
 /* Prevents write operations on FILE's underlying inode
  * until file_allow_write() is called or FILE is closed. */
 void file_deny_write(struct file *file) {
@@ -2,10 +2,17 @@
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/vaddr.h"
 #include <debug.h>
 #include <list.h>
 #include <round.h>
 #include <string.h>
+#ifdef VM
+#include "vm/vm.h"
+#else
+#define file_index_read(INODE, BUF, SIZE, OFS) false
+#define file_index_write(INODE, BUF, SIZE, OFS, LOADED_ONLY) ((void)0)
+#endif
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
@@ -195,7 +202,9 @@ off_t inode_read_at(struct inode *inode, void *buffer_, off_t size, off_t offset
         if (chunk_size <= 0)
             break;
 
-        if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
+        if (file_index_read(inode, buffer + bytes_read, chunk_size, offset)) {
+            /* Mapped into memory, where it may be newer than on disk. */
+        } else if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
             /* Read full sector directly into caller's buffer. */
             disk_read(filesys_disk, sector_idx, buffer + bytes_read);
         } else {
@@ -249,6 +258,8 @@ off_t inode_write_at(struct inode *inode, const void *buffer_, off_t size,
         if (chunk_size <= 0)
             break;
 
+        /* Keep a page of the file mapped into memory up to date. */
+        file_index_write(inode, buffer + bytes_written, chunk_size, offset, true);
         if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
             /* Write full sector directly to disk. */
             disk_write(filesys_disk, sector_idx, buffer + bytes_written);
@@ -270,6 +281,7 @@ off_t inode_write_at(struct inode *inode, const void *buffer_, off_t size,
             memcpy(bounce + sector_ofs, buffer + bytes_written, chunk_size);
             disk_write(filesys_disk, sector_idx, bounce);
         }
+        file_index_write(inode, buffer + bytes_written, chunk_size, offset, false);
 
         /* Advance. */
         size -= chunk_size;
@@ -281,6 +293,71 @@ off_t inode_write_at(struct inode *inode, const void *buffer_, off_t size,
     return bytes_written;
 }
 
+/* Writes SIZE bytes into INODE at OFFSET, which must be page-aligned,
+ * taking them from PAGES, PGSIZE bytes from each page in turn.  Whole
+ * sectors go to the disk with as few commands as possible, since the
+ * data of an inode is contiguous on disk; a partial sector at the end
+ * goes through inode_write_at().
+ * Returns the number of bytes actually written, which may be less than
+ * SIZE if end of file is reached or an error occurs. */
+off_t inode_write_pages(struct inode *inode, void *const pages[], off_t size,
+                        off_t offset) {
+    const size_t sectors_per_page = PGSIZE / DISK_SECTOR_SIZE;
+    const void **sectors;
+    size_t sector_cnt, done, i;
+    off_t full;
+
+    ASSERT(offset % PGSIZE == 0);
+    if (inode->deny_write_cnt)
+        return 0;
+    if (size > inode_length(inode) - offset)
+        size = inode_length(inode) - offset;
+    if (size <= 0)
+        return 0;
+
+    sector_cnt = size / DISK_SECTOR_SIZE;
+    sectors = malloc(DISK_MULTIPLE_MAX * sizeof *sectors);
+    if (sectors == NULL)
+        sector_cnt = 0;
+    full = sector_cnt * DISK_SECTOR_SIZE;
+
+    /* Keep pages of the file mapped into memory up to date, as
+     * inode_write_at() does. */
+    for (i = 0; i * PGSIZE < (size_t)full; i++)
+        file_index_write(inode, pages[i],
+                         full - i * PGSIZE < PGSIZE ? full - i * PGSIZE : PGSIZE,
+                         offset + i * PGSIZE, true);
+    for (done = 0; done < sector_cnt; done += i) {
+        for (i = 0; i < DISK_MULTIPLE_MAX && done + i < sector_cnt; i++) {
+            size_t s = done + i;
+            sectors[i] = (const uint8_t *)pages[s / sectors_per_page] +
+                         s % sectors_per_page * DISK_SECTOR_SIZE;
+        }
+        disk_write_multiple(filesys_disk, byte_to_sector(inode, offset) + done,
+                            sectors, i);
+    }
+    for (i = 0; i * PGSIZE < (size_t)full; i++)
+        file_index_write(inode, pages[i],
+                         full - i * PGSIZE < PGSIZE ? full - i * PGSIZE : PGSIZE,
+                         offset + i * PGSIZE, false);
+    free(sectors);
+
+    /* What is left of a partial last sector, or everything if we are out
+     * of memory, one page at a time. */
+    while (full < size) {
+        off_t page_left = PGSIZE - full % PGSIZE;
+        off_t chunk = size - full < page_left ? size - full : page_left;
+        off_t written = inode_write_at(inode,
+                                       (uint8_t *)pages[full / PGSIZE] + full % PGSIZE,
+                                       chunk, offset + full);
+
+        full += written;
+        if (written != chunk)
+            break;
+    }
+    return full;
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 void inode_deny_write(struct inode *inode) {
@@ -301,3 +378,8 @@ void inode_allow_write(struct inode *inode) {
 off_t inode_length(const struct inode *inode) {
     return inode->data.length;
 }
+
+/* Returns true if writes to INODE are denied. */
+bool inode_write_denied(const struct inode *inode) {
+    return inode->deny_write_cnt > 0;
+}
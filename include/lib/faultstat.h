@@ -0,0 +1,31 @@
+#ifndef __LIB_FAULTSTAT_H
+#define __LIB_FAULTSTAT_H
+
+#include <stdint.h>
+
+/* Kinds of page fault that the kernel times. */
+enum fault_class {
+    FAULT_UNINIT,  /* First touch of a lazily loaded executable page. */
+    FAULT_SWAP_IN, /* Anonymous page read back from swap. */
+    FAULT_FILE,    /* File-backed page read from its file. */
+    FAULT_COW,     /* Write to a page shared copy-on-write. */
+    FAULT_STACK,   /* Access that grew the stack. */
+    FAULT_ZERO,    /* First touch of zero-filled anonymous memory. */
+    FAULT_CLASS_CNT
+};
+
+/* Buckets of a latency histogram. Bucket 0 counts faults that took
+   fewer than 1024 TSC cycles, bucket I > 0 those that took
+   [2**(9+I), 2**(10+I)) cycles, and the last bucket everything
+   longer. */
+#define FAULT_HIST_BUCKETS 20
+
+/* Page fault latencies, as reported by the faultstat system call. */
+struct faultstat {
+    uint64_t proc_count[FAULT_CLASS_CNT]; /* Faults of this process. */
+    uint64_t count[FAULT_CLASS_CNT];      /* Faults of every process. */
+    uint64_t cycles[FAULT_CLASS_CNT];     /* Their total latency. */
+    uint64_t hist[FAULT_CLASS_CNT][FAULT_HIST_BUCKETS];
+};
+
+#endif /* lib/faultstat.h */
@@ -0,0 +1,12 @@
+#ifndef __LIB_MADVISE_H
+#define __LIB_MADVISE_H
+
+/* Advice for the madvise system call, with the same values as on
+   Linux. Advice is kept per region, so a range that covers only part
+   of a region changes the whole region's access pattern. */
+#define MADV_NORMAL 0     /* No particular access pattern. */
+#define MADV_SEQUENTIAL 2 /* Read front to back; drop what was read. */
+#define MADV_WILLNEED 3   /* Load the range in the background. */
+#define MADV_DONTNEED 4   /* Free the range; reload or zero it later. */
+
+#endif /* lib/madvise.h */
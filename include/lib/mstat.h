@@ -0,0 +1,17 @@
+#ifndef __LIB_MSTAT_H
+#define __LIB_MSTAT_H
+
+#include <stddef.h>
+
+/* Memory use of a process, as reported by the mstat system call.
+   All counts are in pages. */
+struct mstat {
+    size_t rss;      /* Pages in memory. */
+    size_t shared;   /* Of those, pages whose frame other pages map too. */
+    size_t swapped;  /* Pages out on swap. */
+    size_t wss;      /* Pages used during the last sample interval. */
+    size_t peak_rss; /* Highest RSS seen at a sample. */
+    size_t peak_wss; /* Highest WSS seen at a sample. */
+};
+
+#endif /* lib/mstat.h */
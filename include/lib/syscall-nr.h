@@ -36,6 +36,13 @@ enum {
 
     SYS_MOUNT,
     SYS_UMOUNT,
+
+    /* Extra for Project 3 */
+    SYS_MSTAT,   /* Report the memory use of this process. */
+    SYS_MADVISE, /* Give advice about the use of a range of memory. */
+    SYS_MSYNC,   /* Write back the dirty pages of memory mappings. */
+    SYS_STACKLIMIT, /* Set the most the user stack may grow to. */
+    SYS_FAULTSTAT,  /* Report page fault latencies. */
 };
 
 #endif /* lib/syscall-nr.h */
@@ -2,6 +2,9 @@
 #define __LIB_USER_SYSCALL_H
 
 #include <debug.h>
+#include <faultstat.h>
+#include <madvise.h>
+#include <mstat.h>
 #include <stdbool.h>
 #include <stddef.h>
 
@@ -41,6 +44,11 @@ int dup2(int oldfd, int newfd);
 /* Project 3 and optionally project 4. */
 void *mmap(void *addr, size_t length, int writable, int fd, off_t offset);
 void munmap(void *addr);
+int mstat(struct mstat *st);
+int madvise(void *addr, size_t length, int advice);
+int msync(void *addr, size_t length);
+int stacklimit(size_t size);
+int faultstat(struct faultstat *fs);
 
 /* Project 4 only. */
 bool chdir(const char *dir);
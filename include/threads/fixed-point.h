@@ -0,0 +1,39 @@
+#ifndef THREADS_FIXED_POINT_H
+#define THREADS_FIXED_POINT_H
+
+#include <stdint.h>
+
+/* Signed 17.14 fixed-point numbers, as used by the multi-level
+ * feedback queue scheduler for recent_cpu and load_avg. */
+typedef int fixed_t;
+
+#define FP_F (1 << 14) /* 1.0 in fixed point. */
+
+/* Converts integer N to fixed point. */
+static inline fixed_t fp_from_int(int n) {
+    return n * FP_F;
+}
+
+/* Converts X to an integer, rounding toward zero. */
+static inline int fp_to_int(fixed_t x) {
+    return x / FP_F;
+}
+
+/* Converts X to an integer, rounding to nearest. */
+static inline int fp_round(fixed_t x) {
+    return x >= 0 ? (x + FP_F / 2) / FP_F : (x - FP_F / 2) / FP_F;
+}
+
+static inline fixed_t fp_add_int(fixed_t x, int n) {
+    return x + n * FP_F;
+}
+
+static inline fixed_t fp_mul(fixed_t x, fixed_t y) {
+    return (int64_t)x * y / FP_F;
+}
+
+static inline fixed_t fp_div(fixed_t x, fixed_t y) {
+    return (int64_t)x * FP_F / y;
+}
+
+#endif /* threads/fixed-point.h */
@@ -3,6 +3,7 @@
 
 #include "threads/pte.h"
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 typedef bool pte_for_each_func(uint64_t *pte, void *va, void *aux);
@@ -12,6 +13,7 @@ uint64_t *pml4_create(void);
 bool pml4_for_each(uint64_t *, pte_for_each_func *, void *);
 void pml4_destroy(uint64_t *pml4);
 void pml4_activate(uint64_t *pml4);
+void pml4_pcid_init(void);
 void *pml4_get_page(uint64_t *pml4, const void *upage);
 bool pml4_set_page(uint64_t *pml4, void *upage, void *kpage, bool rw);
 void pml4_clear_page(uint64_t *pml4, void *upage);
@@ -19,6 +21,32 @@ bool pml4_is_dirty(uint64_t *pml4, const void *upage);
 void pml4_set_dirty(uint64_t *pml4, const void *upage, bool dirty);
 bool pml4_is_accessed(uint64_t *pml4, const void *upage);
 void pml4_set_accessed(uint64_t *pml4, const void *upage, bool accessed);
+bool pml4_promote(uint64_t *pml4, void *upage);
+bool pml4_is_huge(uint64_t *pml4, const void *upage);
+void pml4_clear_huge_accessed(uint64_t *pml4, const void *upage);
+
+/* Number of 2 MB mappings broken back into page tables. */
+extern uint64_t pml4_huge_splits;
+
+/* Whether to tag address spaces with PCIDs, if the CPU can. Cleared at
+ * boot with "-no-pcid", or by pml4_pcid_init() if the CPU cannot. */
+extern bool pml4_use_pcid;
+/* Address space switches that kept the TLB, and that flushed it. */
+extern uint64_t pml4_switches_kept, pml4_switches_flushed;
+/* Teardown batches that ended with a flush, and INVLPGs they saved. */
+extern uint64_t pml4_batch_flushes, pml4_batch_saved;
+
+/* Invalidations of the running address space collected by a teardown,
+ * such as munmap() or process exit, between pml4_batch_begin() and
+ * pml4_batch_end(). Lives on the caller's stack. */
+#define TLB_BATCH_MAX 16U
+struct tlb_batch {
+    uint64_t *pml4;             /* Address space being torn down. */
+    size_t cnt;                 /* Pages invalidated so far. */
+    uint64_t va[TLB_BATCH_MAX]; /* The first of them. */
+};
+void pml4_batch_begin(struct tlb_batch *batch, uint64_t *pml4);
+void pml4_batch_end(struct tlb_batch *batch);
 
 #define is_writable(pte) (*(pte) & PTE_W)
 #define is_user_pte(pte) (*(pte) & PTE_U)
@@ -2,6 +2,7 @@
 #define THREADS_THREAD_H
 
 #include "filesys/file.h"
+#include "threads/fixed-point.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
 #include <debug.h>
@@ -97,6 +98,9 @@ struct thread
     int priority;              /* Priority. */
     int origin_priority;       /* origin Priority*/
     int64_t wake_tick;         /* 일어날 시간 */
+    int nice;                  /* Niceness, for the MLFQS. */
+    fixed_t recent_cpu;        /* Recent CPU time, for the MLFQS. */
+    struct list_elem all_elem; /* all_list element. */
     int fd_count;              /* file descriptor count */
 
     struct list donations;     /* 기부해준 스레드 리스트 */
@@ -118,11 +122,22 @@ struct thread
     /* Owned by userprog/process.c. */
     uint64_t *pml4; /* Page map level 4 */
     uint64_t *parent_pml4;
+    struct tlb_batch *tlb_batch; /* Invalidations being batched, or NULL. */
 #endif
 #ifdef VM
     /* Table for whole virtual memory owned by thread. */
     struct supplemental_page_table spt;
     uint64_t user_rsp;
+    void *stack_bottom;      /* Lowest page of the user stack. */
+    size_t stack_limit;      /* Most bytes the user stack may grow to. */
+    long long around_mapped; /* Pages mapped by fault-around. */
+    long long around_saved;  /* Of those, pages the process then used. */
+    int64_t ws_next;         /* Tick of the next working-set sample. */
+    size_t wss;              /* Pages used in the last sample interval. */
+    size_t peak_rss;         /* Most pages resident at a sample. */
+    size_t peak_wss;         /* Largest working set sampled. */
+    int prefetch_pending;    /* Pages queued by MADV_WILLNEED. */
+    uint64_t fault_cnt[FAULT_CLASS_CNT]; /* Timed faults, by class. */
 #endif
 
     /* Owned by thread.c. */
@@ -168,10 +183,14 @@ void do_iret(struct intr_frame *tf);
 /* alarm clock function*/
 void thread_sleep(int64_t wake_tick);
 void thread_awake(int64_t ticks);
+int thread_next_wakeup(int max);
+void thread_tick_idle(void);
+bool thread_idle_alone(void);
 
 /* priority schedule */
 bool compare_priority(const struct list_elem *a, const struct list_elem *b, void *aux);
 void imm_preempt(struct thread *t);
 void ready_list_preempt();
+void thread_change_priority(struct thread *t, int priority);
 
 #endif /* threads/thread.h */
@@ -1,13 +1,23 @@
 #ifndef VM_ANON_H
 #define VM_ANON_H
 #include "vm/vm.h"
+#include <stddef.h>
 struct page;
+struct frame;
 enum vm_type;
 
 struct anon_page {
 };
 
+/* Swap devices, a comma-separated list of "hd1:D" or "ram:PAGES", each
+ * optionally followed by "@PRIO". Set at boot with "-swap=LIST". */
+extern const char *swap_devices;
+
 void vm_anon_init (void);
 bool anon_initializer (struct page *page, enum vm_type type, void *kva);
+void swap_slot_dup (size_t slot_idx);
+void swap_slot_free (size_t slot_idx);
+size_t anon_swap_out_cluster (struct frame *frames[], size_t cnt);
+void anon_print_stats (void);
 
 #endif
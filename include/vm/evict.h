@@ -0,0 +1,42 @@
+#ifndef VM_EVICT_H
+#define VM_EVICT_H
+#include <stdbool.h>
+#include <stdint.h>
+
+struct frame;
+struct page;
+
+/* Counters kept by every replacement policy. */
+struct evict_stats
+{
+    uint64_t hits;       /* Referenced frames spared by a scan. */
+    uint64_t faults;     /* Frames made resident. */
+    uint64_t evictions;  /* Victims handed out. */
+    uint64_t ghost_hits; /* Faults on recently evicted pages. */
+};
+
+/* A page replacement policy.
+ * Every hook is called with frame_lock held. FRAMEs passed to admit()
+ * already have their reverse map set up. victim() must unlink the frame
+ * it returns from the policy's own bookkeeping. */
+struct evict_policy
+{
+    const char *name;
+    void (*init)(void);
+    void (*admit)(struct frame *frame);
+    void (*remove)(struct frame *frame);
+    struct frame *(*victim)(void);
+    struct evict_stats stats;
+};
+
+bool evict_set_policy(const char *name);
+void evict_init(void);
+void evict_admit(struct frame *frame);
+void evict_putback(struct frame *frame);
+void evict_remove(struct frame *frame);
+void evict_deactivate(struct frame *frame);
+struct frame *evict_pick(void);
+void evict_forget(struct page *page);
+void evict_print_stats(void);
+
+#endif /* vm/evict.h */
@@ -4,6 +4,9 @@
 #include "vm/vm.h"
 
 struct page;
+struct frame;
+struct inode;
+struct vma;
 enum vm_type;
 
 struct file_page {
@@ -14,4 +17,17 @@ bool file_backed_initializer (struct page *page, enum vm_type type, void *kva);
 void *do_mmap(void *addr, size_t length, int writable,
 		struct file *file, off_t offset);
 void do_munmap (void *va);
+int do_msync (void *addr, size_t length);
+size_t file_writeback_range (struct vma *vma, void *start, void *end);
+void file_vma_writeback (struct vma *vma);
+
+bool file_page_shareable (struct vma *vma, void *va);
+struct frame *file_index_lookup (struct inode *inode, off_t ofs);
+void file_index_insert (struct frame *frame, struct inode *inode, off_t ofs);
+void file_index_remove (struct frame *frame);
+void file_index_note_share (struct vma *vma);
+bool file_index_read (struct inode *inode, void *buf, off_t size, off_t ofs);
+void file_index_write (struct inode *inode, const void *buf, off_t size,
+		off_t ofs, bool loaded_only);
+void file_print_stats (void);
 #endif
@@ -0,0 +1,15 @@
+#ifndef VM_KSWAPD_H
+#define VM_KSWAPD_H
+#include <stddef.h>
+
+/* Free user-pool page counts that wake kswapd and let it sleep again.
+ * Zero means the default, set from the pool size by kswapd_init(). */
+extern size_t kswapd_low_wmark;
+extern size_t kswapd_high_wmark;
+
+void kswapd_init(void);
+void kswapd_poke(void);
+void kswapd_note_direct(size_t cnt);
+void kswapd_print_stats(void);
+
+#endif /* vm/kswapd.h */
@@ -1,5 +1,6 @@
 #ifndef VM_VM_H
 #define VM_VM_H
+#include <faultstat.h>
 #include <stdbool.h>
 #include "threads/palloc.h"
 #include "lib/kernel/hash.h"
@@ -26,6 +27,11 @@ enum vm_type
     VM_MARKER_END = (1 << 31),
 };
 
+/* Marks the read-only segments of an executable. They are file pages,
+ * shared by every process running the same binary and dropped instead of
+ * swapped, but are not memory mappings that munmap() could remove. */
+#define VM_TEXT VM_MARKER_1
+
 #include "vm/uninit.h"
 #include "vm/anon.h"
 #include "vm/file.h"
@@ -35,9 +41,25 @@ enum vm_type
 
 struct page_operations;
 struct thread;
+struct vma;
+struct spt_snapshot;
 
 #define VM_TYPE(type) ((type) & 7)
 
+/* Largest size of the user stack, and the most a process may raise its
+ * stack limit to. Memory mappings keep clear of this much. */
+#define STACK_MAX (1 << 20)
+
+/* Bytes below the stack pointer that may be touched without moving it
+ * first, and pages added below a fault that grows the stack. */
+extern size_t stack_red_zone;
+extern size_t stack_growth_pages;
+
+/* Pages mapped around a fault in a file-backed region, 0 or 1 to turn
+ * fault-around off. */
+extern size_t fault_around_pages;
+extern bool huge_pages;
+
 /* The representation of "page".
  * This is kind of "parent class", which has four "child class"es, which are
  * uninit_page, file_page, anon_page, and page cache (project4).
@@ -63,26 +85,44 @@ struct page
     };
     struct hash_elem hash_elem;
     bool writable;
-    bool is_last_file_page;
     size_t slot_idx;
     bool original_writable;
+    struct thread *owner;        /* Process whose spt holds this page. */
+    struct list_elem rmap_elem;  /* Element in frame's reverse map. */
+    bool ghost;                  /* Remembered by the eviction policy. */
+    struct list_elem ghost_elem; /* Element in the policy's ghost list. */
+    struct vma *vma;             /* Region the page belongs to, or NULL. */
+    struct list_elem vma_elem;   /* Element in the region's page list. */
+    bool around;                 /* Mapped by fault-around, not yet used. */
+    bool young;                  /* Accessed bit taken by a WSS sample. */
+    uint8_t prefetch;            /* PREFETCH_*, see vm_madvise(). */
+    int frozen_refs;             /* Frozen: holders yet to thaw it. */
 };
 
-/* The representation of "frame" */
-struct frame
+/* States of a page that MADV_WILLNEED loads in the background. */
+enum
 {
-    void *kva;
-    struct page *page;
-    struct list_elem elem;
-    int ref_count;
+    PREFETCH_NONE,    /* Not being prefetched. */
+    PREFETCH_PENDING, /* Has a frame that prefetchd is filling. */
+    PREFETCH_READY,   /* Loaded but not mapped until first touch. */
+    PREFETCH_FAILED,  /* Could not be loaded; touching it fails. */
 };
 
-struct load_info
+/* The representation of "frame" */
+struct frame
 {
-    struct file *file;
-    size_t page_read_bytes;
-    size_t page_zero_bytes;
-    off_t offset;
+    void *kva;
+    struct page *page;     /* First page in RMAP, NULL if unmapped. */
+    struct list_elem elem; /* Element in the replacement policy's lists. */
+    struct list rmap;      /* Every page that maps this frame. */
+    int ref_count;         /* Number of pages in RMAP. */
+    bool evicting;         /* Being swapped out, not held by the policy. */
+    bool inactive;         /* Deactivated, first in line for eviction. */
+    bool loading;          /* Contents being read in; not to be shared. */
+    struct inode *inode;   /* File whose page it holds, or NULL. */
+    off_t file_ofs;        /* Offset of that page in INODE. */
+    struct hash_elem index_elem; /* Element in the file page index. */
+    uint8_t evict_state;   /* Private to the replacement policy. */
 };
 
 /* The function table for page operations.
@@ -108,7 +148,9 @@ struct page_operations
  * All designs up to you for this. */
 struct supplemental_page_table
 {
-    struct hash pages;
+    struct hash pages;   /* Pages that have been touched, by address. */
+    struct vma *regions; /* Root of the region tree, see vma.c. */
+    struct spt_snapshot *snap; /* Pages frozen at fork, or NULL. */
 };
 
 #include "threads/thread.h"
@@ -118,6 +160,7 @@ bool supplemental_page_table_copy(struct supplemental_page_table *dst,
 void supplemental_page_table_kill(struct supplemental_page_table *spt);
 struct page *spt_find_page(struct supplemental_page_table *spt,
                            void *va);
+struct page *spt_get_page(struct supplemental_page_table *spt, void *va);
 bool spt_insert_page(struct supplemental_page_table *spt, struct page *page);
 void spt_remove_page(struct supplemental_page_table *spt, struct page *page);
 
@@ -131,10 +174,23 @@ bool vm_alloc_page_with_initializer(enum vm_type type, void *upage,
                                     bool writable, vm_initializer *init, void *aux);
 void vm_dealloc_page(struct page *page);
 bool vm_claim_page(void *va);
+size_t vm_reclaim_frame(void);
 enum vm_type page_get_type(struct page *page);
+struct mstat;
+void vm_mstat(struct mstat *st);
+void vm_sample_ws(void);
+void vm_mstat_record(void);
+int vm_madvise(void *addr, size_t length, int advice);
+int vm_set_stack_limit(size_t size);
+void vm_faultstat(struct faultstat *fs);
+void vm_prefetch_drain(struct thread *t);
 
 unsigned page_hash(const struct hash_elem *p_, void *aux UNUSED);
 bool page_less(const struct hash_elem *a_, const struct hash_elem *b_, void *aux UNUSED);
-void free_frame(struct frame *frame);
+void free_frame(struct page *page);
+bool frame_unmap_all(struct frame *frame);
+void frame_wake_waiters(void);
+bool frame_test_and_clear_accessed(struct frame *frame);
+void vm_print_stats(void);
 
 #endif /* VM_VM_H */
@@ -0,0 +1,52 @@
+#ifndef VM_VMA_H
+#define VM_VMA_H
+#include "filesys/off_t.h"
+#include "lib/kernel/list.h"
+#include "vm/vm.h"
+
+struct file;
+
+/* A virtual memory area: a page-aligned range of user addresses that is
+ * backed the same way throughout, e.g. one mmap() or one executable
+ * segment. Per-page struct pages are created from it on first touch
+ * and are kept on PAGES until they go away.
+ * Regions of a process live in a balanced tree sorted by address. */
+struct vma
+{
+    void *start;           /* First address, page-aligned. */
+    void *end;             /* One past the last address, page-aligned. */
+    enum vm_type type;     /* Type of the pages, as to vm_alloc_page(). */
+    bool writable;         /* Whether the pages may be written. */
+    struct file *file;     /* Backing file, owned by the region, or NULL. */
+    off_t offset;          /* Offset in FILE of START. */
+    size_t read_bytes;     /* Bytes of FILE from START; the rest is zero. */
+    vm_initializer *init;  /* Loads one page, with the region as aux. */
+    struct list pages;     /* Pages created from the region. */
+    int advice;            /* MADV_* access pattern, see madvise.h. */
+    void *seq_mark;        /* Under MADV_SEQUENTIAL, first address not
+                              yet handed to the evictor. */
+
+    struct vma *left;      /* Regions below START. */
+    struct vma *right;     /* Regions at or above END. */
+    int height;            /* Height of the subtree rooted here. */
+};
+
+struct vma *vma_create(void *start, size_t length, enum vm_type type,
+                       bool writable, struct file *file, off_t offset,
+                       size_t read_bytes, vm_initializer *init);
+void vma_destroy(struct vma *vma);
+off_t vma_page_offset(const struct vma *vma, const void *va);
+size_t vma_page_read_bytes(const struct vma *vma, const void *va);
+
+bool spt_insert_vma(struct supplemental_page_table *spt, struct vma *vma);
+void spt_remove_vma(struct supplemental_page_table *spt, struct vma *vma);
+struct vma *spt_find_vma(struct supplemental_page_table *spt, const void *va);
+bool spt_overlaps_vma(struct supplemental_page_table *spt, const void *start,
+                      const void *end);
+bool spt_copy_vmas(struct supplemental_page_table *dst,
+                   struct supplemental_page_table *src);
+void spt_for_each_vma(struct supplemental_page_table *spt,
+                      void (*func)(struct vma *));
+void spt_destroy_vmas(struct supplemental_page_table *spt);
+
+#endif /* vm/vma.h */
@@ -0,0 +1,20 @@
+#ifndef VM_ZSWAP_H
+#define VM_ZSWAP_H
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Most kernel pages the compressed pool may use, zero to disable it.
+ * Set at boot with "-zswap=PAGES". */
+extern size_t zswap_max_pages;
+
+/* Writes the uncompressed contents KVA of SLOT_IDX to the swap disk. */
+typedef void zswap_writeback_func(size_t slot_idx, const void *kva);
+
+void zswap_init(size_t slot_cnt, zswap_writeback_func *writeback);
+bool zswap_store(size_t slot_idx, const void *kva);
+bool zswap_load(size_t slot_idx, void *kva);
+bool zswap_contains(size_t slot_idx);
+void zswap_invalidate(size_t slot_idx);
+void zswap_print_stats(void);
+
+#endif /* vm/zswap.h */
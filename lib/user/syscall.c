@@ -139,6 +139,26 @@ void munmap(void *addr) {
     syscall1(SYS_MUNMAP, addr);
 }
 
+int mstat(struct mstat *st) {
+    return syscall1(SYS_MSTAT, st);
+}
+
+int madvise(void *addr, size_t length, int advice) {
+    return syscall3(SYS_MADVISE, addr, length, advice);
+}
+
+int msync(void *addr, size_t length) {
+    return syscall2(SYS_MSYNC, addr, length);
+}
+
+int stacklimit(size_t size) {
+    return syscall1(SYS_STACKLIMIT, size);
+}
+
+int faultstat(struct faultstat *fs) {
+    return syscall1(SYS_FAULTSTAT, fs);
+}
+
 bool chdir(const char *dir) {
     return syscall1(SYS_CHDIR, dir);
 }
@@ -0,0 +1,74 @@
+/* Checks that faultstat counts the stack growth and copy-on-write
+   faults of a process, and that every timed fault lands in one bucket
+   of its class's histogram. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+
+static struct faultstat fs;
+static char page[PAGE_SIZE];
+
+/* Uses about DEPTH pages of stack. */
+static int
+recurse (int depth)
+{
+  volatile char buf[PAGE_SIZE];
+
+  buf[0] = depth;
+  if (depth == 0)
+    return buf[0];
+  return recurse (depth - 1) + buf[0];
+}
+
+/* Fails unless the histograms of FS add up to its counts. */
+static void
+check_histograms (void)
+{
+  int c, b;
+
+  for (c = 0; c < FAULT_CLASS_CNT; c++)
+    {
+      uint64_t sum = 0;
+
+      for (b = 0; b < FAULT_HIST_BUCKETS; b++)
+        sum += fs.hist[c][b];
+      if (sum != fs.count[c])
+        fail ("class %d: histogram holds %llu faults, count is %llu",
+              c, sum, fs.count[c]);
+      if (fs.proc_count[c] > fs.count[c])
+        fail ("class %d: process count %llu above total %llu",
+              c, fs.proc_count[c], fs.count[c]);
+    }
+}
+
+void
+test_main (void)
+{
+  pid_t pid;
+
+  page[0] = 1;
+  recurse (16);
+  CHECK (faultstat (&fs) == 0, "faultstat after growing the stack");
+  if (fs.proc_count[FAULT_STACK] == 0)
+    fail ("no stack growth faults counted");
+  check_histograms ();
+
+  pid = fork ("child");
+  if (pid == 0)
+    {
+      uint64_t cow;
+
+      CHECK (faultstat (&fs) == 0, "faultstat in child");
+      cow = fs.proc_count[FAULT_COW];
+      page[0] = 2;
+      CHECK (faultstat (&fs) == 0, "faultstat after copy on write");
+      if (fs.proc_count[FAULT_COW] <= cow)
+        fail ("no copy-on-write fault counted");
+      check_histograms ();
+      exit (0);
+    }
+  CHECK (wait (pid) == 0, "wait for child");
+}
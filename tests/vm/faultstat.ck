@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(faultstat) begin
+(faultstat) faultstat after growing the stack
+(faultstat) faultstat in child
+(faultstat) faultstat after copy on write
+child: exit(0)
+(faultstat) wait for child
+(faultstat) end
+faultstat: exit(0)
+EOF
+pass;
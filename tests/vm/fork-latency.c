@@ -0,0 +1,60 @@
+/* Forks a process whose address space grows from 1 MB to 64 MB and
+   reports how many TSC cycles each fork took the parent.  One page in
+   every 64 kB is read and one in every megabyte is written, so the cost
+   of a fork should follow the pages in use, 16 per megabyte, not the
+   size of the address space.  Each child checks that it sees the
+   parent's data and exits with the size in megabytes. */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define MB (1024 * 1024)
+#define MAX_SIZE (64 * MB)
+#define STRIDE (64 * 1024)
+
+static char buf[MAX_SIZE];
+
+static uint64_t
+rdtsc (void)
+{
+  uint32_t lo, hi;
+
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+
+void
+test_main (void)
+{
+  volatile char sink;
+  size_t size, i;
+
+  for (size = MB; size <= MAX_SIZE; size *= 2)
+    {
+      uint64_t cycles;
+      pid_t pid;
+
+      for (i = 0; i < size; i += STRIDE)
+        if (i % MB == 0)
+          buf[i] = i / MB + 1;
+        else
+          sink = buf[i];
+
+      cycles = rdtsc ();
+      pid = fork ("child");
+      if (pid == 0)
+        {
+          for (i = 0; i < size; i += MB)
+            if (buf[i] != (char) (i / MB + 1))
+              fail ("child sees wrong data at %zu MB", i / MB);
+          exit (size / MB);
+        }
+      cycles = rdtsc () - cycles;
+      CHECK (wait (pid) == (int) (size / MB), "wait for child");
+      msg ("fork with %zu MB address space took %llu cycles",
+           size / MB, cycles);
+    }
+  (void) sink;
+}
@@ -0,0 +1,36 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+# The cycle counts differ from run to run.
+s/ took \d+ cycles$// foreach @output;
+compare_output ("run", \@output, [<<'EOF']);
+(fork-latency) begin
+child: exit(1)
+(fork-latency) wait for child
+(fork-latency) fork with 1 MB address space
+child: exit(2)
+(fork-latency) wait for child
+(fork-latency) fork with 2 MB address space
+child: exit(4)
+(fork-latency) wait for child
+(fork-latency) fork with 4 MB address space
+child: exit(8)
+(fork-latency) wait for child
+(fork-latency) fork with 8 MB address space
+child: exit(16)
+(fork-latency) wait for child
+(fork-latency) fork with 16 MB address space
+child: exit(32)
+(fork-latency) wait for child
+(fork-latency) fork with 32 MB address space
+child: exit(64)
+(fork-latency) wait for child
+(fork-latency) fork with 64 MB address space
+(fork-latency) end
+fork-latency: exit(0)
+EOF
+pass;
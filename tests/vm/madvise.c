@@ -0,0 +1,88 @@
+/* Gives each kind of advice to madvise and checks that memory still
+   reads back as it should: a mapping prefetched with MADV_WILLNEED
+   holds the file's data, a buffer dropped with MADV_DONTNEED reads
+   back as zeros, also in a child and its parent that still share it
+   after a fork, and a buffer scanned under MADV_SEQUENTIAL keeps what
+   was written to it. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGES 32
+
+static char buf[PAGES * PAGE_SIZE] __attribute__ ((aligned (PAGE_SIZE)));
+
+/* Drops BUF and checks that it reads back as zeros. */
+static void
+drop_buf (const char *who)
+{
+  size_t i;
+
+  CHECK (madvise (buf, sizeof buf, MADV_DONTNEED) == 0,
+         "%s: madvise buffer MADV_DONTNEED", who);
+  for (i = 0; i < PAGES; i++)
+    if (buf[i * PAGE_SIZE] != 0)
+      fail ("%s: page %zu of dropped buffer has value %d (should be 0)",
+            who, i, buf[i * PAGE_SIZE]);
+}
+
+void
+test_main (void)
+{
+  char *actual = (char *) 0x10000000;
+  int handle;
+  void *map;
+  pid_t pid;
+  size_t i;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK ((map = mmap (actual, 4096, 0, handle, 0)) != MAP_FAILED,
+         "mmap \"sample.txt\"");
+  CHECK (madvise (actual, 4096, MADV_WILLNEED) == 0,
+         "madvise mapping MADV_WILLNEED");
+  if (memcmp (actual, sample, strlen (sample)))
+    fail ("read of prefetched mapping reported bad data");
+
+  CHECK (madvise (actual + 1, 4096, MADV_WILLNEED) == -1,
+         "madvise misaligned address");
+  CHECK (madvise ((char *) 0x20000000, 4096, MADV_WILLNEED) == -1,
+         "madvise unmapped address");
+
+  for (i = 0; i < PAGES; i++)
+    buf[i * PAGE_SIZE] = i + 1;
+  drop_buf ("parent");
+
+  /* Both sides see the same frozen pages after the fork; dropping them
+     on one side must neither bring the old data back there nor take it
+     away from the other. */
+  for (i = 0; i < PAGES; i++)
+    buf[i * PAGE_SIZE] = i + 1;
+  pid = fork ("child");
+  if (pid == 0)
+    {
+      drop_buf ("child");
+      exit (0);
+    }
+  CHECK (wait (pid) == 0, "wait for child");
+  for (i = 0; i < PAGES; i++)
+    if (buf[i * PAGE_SIZE] != (char) (i + 1))
+      fail ("page %zu of shared buffer has value %d (should be %zu)",
+            i, buf[i * PAGE_SIZE], i + 1);
+  drop_buf ("parent");
+
+  CHECK (madvise (buf, sizeof buf, MADV_SEQUENTIAL) == 0,
+         "madvise buffer MADV_SEQUENTIAL");
+  for (i = 0; i < PAGES; i++)
+    buf[i * PAGE_SIZE] = i + 1;
+  for (i = 0; i < PAGES; i++)
+    if (buf[i * PAGE_SIZE] != (char) (i + 1))
+      fail ("page %zu of sequential buffer has value %d (should be %zu)",
+            i, buf[i * PAGE_SIZE], i + 1);
+
+  munmap (map);
+  close (handle);
+}
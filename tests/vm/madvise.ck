@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(madvise) begin
+(madvise) open "sample.txt"
+(madvise) mmap "sample.txt"
+(madvise) madvise mapping MADV_WILLNEED
+(madvise) madvise misaligned address
+(madvise) madvise unmapped address
+(madvise) parent: madvise buffer MADV_DONTNEED
+(madvise) child: madvise buffer MADV_DONTNEED
+child: exit(0)
+(madvise) wait for child
+(madvise) parent: madvise buffer MADV_DONTNEED
+(madvise) madvise buffer MADV_SEQUENTIAL
+(madvise) end
+madvise: exit(0)
+EOF
+pass;
@@ -0,0 +1,66 @@
+/* Maps a file in two processes and checks that each sees what the
+   other writes through its mapping, and that read() and write() on
+   the file agree with the mappings, all without unmapping first. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((char *) 0x10000000)
+#define OTHER ((char *) 0x20000000)
+
+static char buf[1024];
+
+void
+test_main (void)
+{
+  size_t len = strlen (sample);
+  int handle;
+  pid_t child;
+
+  CHECK (create ("shared.txt", 4096), "create \"shared.txt\"");
+  CHECK ((handle = open ("shared.txt")) > 1, "open \"shared.txt\"");
+  CHECK (mmap (ACTUAL, 4096, 1, handle, 0) != MAP_FAILED,
+         "mmap \"shared.txt\"");
+
+  memcpy (ACTUAL, sample, len);
+  CHECK (read (handle, buf, len) == (int) len, "read \"shared.txt\"");
+  if (memcmp (buf, sample, len))
+    fail ("read() does not see data written through the mapping");
+
+  seek (handle, 0);
+  CHECK (write (handle, "XYZ", 3) == 3, "write \"shared.txt\"");
+  if (memcmp (ACTUAL, "XYZ", 3))
+    fail ("mapping does not see data written with write()");
+
+  child = fork ("child");
+  if (child == 0)
+    {
+      int fd;
+
+      CHECK ((fd = open ("shared.txt")) > 1, "open \"shared.txt\" in child");
+      CHECK (mmap (OTHER, 4096, 1, fd, 0) != MAP_FAILED,
+             "mmap \"shared.txt\" in child");
+      if (memcmp (OTHER, "XYZ", 3) || memcmp (OTHER + 3, sample + 3, len - 3))
+        fail ("child's mapping does not see the parent's data");
+      OTHER[0] = 'Q';
+      exit (0);
+    }
+  CHECK (wait (child) == 0, "wait for child");
+  if (ACTUAL[0] != 'Q')
+    fail ("parent's mapping does not see the child's write");
+
+  CHECK (msync (ACTUAL, 4096) == 0, "msync \"shared.txt\"");
+  CHECK (msync (ACTUAL + 1, 4096) == -1, "msync misaligned address");
+  munmap (ACTUAL);
+  close (handle);
+
+  CHECK ((handle = open ("shared.txt")) > 1, "reopen \"shared.txt\"");
+  CHECK (read (handle, buf, len) == (int) len, "read \"shared.txt\" again");
+  if (buf[0] != 'Q' || memcmp (buf + 1, "YZ", 2)
+      || memcmp (buf + 3, sample + 3, len - 3))
+    fail ("file does not hold the data written through the mappings");
+  close (handle);
+}
@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(mmap-shared) begin
+(mmap-shared) create "shared.txt"
+(mmap-shared) open "shared.txt"
+(mmap-shared) mmap "shared.txt"
+(mmap-shared) read "shared.txt"
+(mmap-shared) write "shared.txt"
+(mmap-shared) open "shared.txt" in child
+(mmap-shared) mmap "shared.txt" in child
+child: exit(0)
+(mmap-shared) wait for child
+(mmap-shared) msync "shared.txt"
+(mmap-shared) msync misaligned address
+(mmap-shared) reopen "shared.txt"
+(mmap-shared) read "shared.txt" again
+(mmap-shared) end
+mmap-shared: exit(0)
+EOF
+pass;
@@ -0,0 +1,43 @@
+/* Checks that mstat counts the pages a process touches as resident,
+   and the pages a child shares with its parent after fork as
+   shared. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGES 64
+
+static char buf[PAGES * PAGE_SIZE];
+
+void
+test_main (void)
+{
+  struct mstat before, after;
+  pid_t pid;
+  size_t i;
+
+  CHECK (mstat (&before) == 0, "mstat before touching");
+  for (i = 0; i < PAGES; i++)
+    buf[i * PAGE_SIZE] = i + 1;
+  CHECK (mstat (&after) == 0, "mstat after touching");
+  if (after.rss < before.rss + PAGES)
+    fail ("RSS grew from %zu to %zu pages, expected at least %d more",
+          before.rss, after.rss, PAGES);
+  if (after.peak_rss < after.rss)
+    fail ("peak RSS %zu below RSS %zu", after.peak_rss, after.rss);
+
+  pid = fork ("child");
+  if (pid == 0)
+    {
+      struct mstat st;
+
+      CHECK (mstat (&st) == 0, "mstat in child");
+      if (st.shared < PAGES)
+        fail ("child shares %zu pages, expected at least %d",
+              st.shared, PAGES);
+      exit (0);
+    }
+  CHECK (wait (pid) == 0, "wait for child");
+}
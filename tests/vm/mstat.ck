@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(mstat) begin
+(mstat) mstat before touching
+(mstat) mstat after touching
+(mstat) mstat in child
+child: exit(0)
+(mstat) wait for child
+(mstat) end
+mstat: exit(0)
+EOF
+pass;
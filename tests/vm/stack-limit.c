@@ -0,0 +1,42 @@
+/* Lowers the stack limit of a child process, checks that the stack
+   still grows up to the limit, and that growing past it kills the
+   child instead of the kernel. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define KB 1024
+
+/* Uses about DEPTH kilobytes of stack. */
+static int
+recurse (int depth)
+{
+  volatile char buf[KB];
+
+  buf[0] = depth;
+  buf[KB - 1] = depth;
+  if (depth == 0)
+    return buf[0];
+  return recurse (depth - 1) + buf[KB - 1];
+}
+
+void
+test_main (void)
+{
+  pid_t pid;
+
+  CHECK (stacklimit (2 * KB * KB) == -1, "limit above the maximum rejected");
+
+  pid = fork ("child");
+  if (pid == 0)
+    {
+      CHECK (stacklimit (64 * KB) == 0, "limit stack to 64 kB");
+      recurse (32);
+      msg ("used 32 kB of stack");
+      CHECK (stacklimit (4 * KB) == -1, "limit below stack in use rejected");
+      recurse (128);
+      fail ("grew past the stack limit");
+    }
+  CHECK (wait (pid) == -1, "wait for child");
+}
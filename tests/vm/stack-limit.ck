@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(stack-limit) begin
+(stack-limit) limit above the maximum rejected
+(stack-limit) limit stack to 64 kB
+(stack-limit) used 32 kB of stack
+(stack-limit) limit below stack in use rejected
+child: exit(-1)
+(stack-limit) wait for child
+(stack-limit) end
+stack-limit: exit(0)
+EOF
+pass;
@@ -30,6 +30,9 @@
 #endif
 #include "tests/threads/tests.h"
 #ifdef VM
+#include "vm/evict.h"
+#include "vm/kswapd.h"
+#include "vm/zswap.h"
 #include "vm/vm.h"
 #endif
 #ifdef FILESYS
@@ -84,6 +87,7 @@ int main(void) {
     mem_end = palloc_init();
     malloc_init();
     paging_init(mem_end);
+    pml4_pcid_init();
 
 #ifdef USERPROG
     tss_init();
@@ -219,11 +223,37 @@ parse_options(char **argv) {
             random_init(atoi(value));
         else if (!strcmp(name, "-mlfqs"))
             thread_mlfqs = true;
+        else if (!strcmp(name, "-tickless"))
+            timer_tickless = true;
 #ifdef USERPROG
         else if (!strcmp(name, "-ul"))
             user_page_limit = atoi(value);
+        else if (!strcmp(name, "-no-pcid"))
+            pml4_use_pcid = false;
         else if (!strcmp(name, "-threads-tests"))
             thread_tests = true;
+#endif
+#ifdef VM
+        else if (!strcmp(name, "-evict")) {
+            if (value == NULL || !evict_set_policy(value))
+                PANIC("unknown eviction policy `%s'", value);
+        }
+        else if (!strcmp(name, "-wmark-low"))
+            kswapd_low_wmark = atoi(value);
+        else if (!strcmp(name, "-wmark-high"))
+            kswapd_high_wmark = atoi(value);
+        else if (!strcmp(name, "-fault-around"))
+            fault_around_pages = atoi(value);
+        else if (!strcmp(name, "-zswap"))
+            zswap_max_pages = atoi(value);
+        else if (!strcmp(name, "-swap"))
+            swap_devices = value;
+        else if (!strcmp(name, "-no-huge"))
+            huge_pages = false;
+        else if (!strcmp(name, "-stack-chunk"))
+            stack_growth_pages = atoi(value);
+        else if (!strcmp(name, "-stack-red-zone"))
+            stack_red_zone = atoi(value);
 #endif
         else
             PANIC("unknown option `%s' (use -h for help)", name);
@@ -323,8 +353,25 @@ usage(void) {
            "  -f                 Format file system disk during startup.\n"
            "  -rs=SEED           Set random number seed to SEED.\n"
            "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+           "  -tickless          Stop the periodic timer while idle.\n"
 #ifdef USERPROG
            "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+           "  -no-pcid           Flush the whole TLB on every address space switch.\n"
+#endif
+#ifdef VM
+           "  -evict=POLICY      Page replacement: clock, 2q or clockpro.\n"
+           "  -wmark-low=COUNT   Wake kswapd below COUNT free user pages.\n"
+           "  -wmark-high=COUNT  Let kswapd sleep at COUNT free user pages.\n"
+           "  -fault-around=N    Map up to N file pages per fault (default 16).\n"
+           "  -zswap=PAGES       Compress swapped pages into up to PAGES kernel\n"
+           "                     pages before using the disk (default 128).\n"
+           "  -no-huge           Never map anonymous memory with 2 MB pages.\n"
+           "  -swap=LIST         Swap to the comma-separated devices hd1:0, hd1:1\n"
+           "                     or ram:PAGES, each with an optional @PRIO; equal\n"
+           "                     priorities are striped (default hd1:1).\n"
+           "  -stack-chunk=N     Grow the user stack N pages at a time (default 4).\n"
+           "  -stack-red-zone=B  Let stack accesses reach B bytes below the stack\n"
+           "                     pointer (default 128).\n"
 #endif
     );
     power_off();
@@ -350,6 +397,7 @@ static void
 print_stats(void) {
     timer_print_stats();
     thread_print_stats();
+    palloc_print_stats();
 #ifdef FILESYS
     disk_print_stats();
 #endif
@@ -358,4 +406,7 @@ print_stats(void) {
 #ifdef USERPROG
     exception_print_stats();
 #endif
+#ifdef VM
+    vm_print_stats();
+#endif
 }
@@ -13,6 +13,9 @@
 #include <stdio.h>
 #ifdef USERPROG
 #include "userprog/gdt.h"
+#ifdef VM
+#include "vm/vm.h"
+#endif
 #endif
 
 /* Number of x86_64 interrupts. */
@@ -359,6 +362,17 @@ void intr_handler(struct intr_frame *frame) {
 
         if (yield_on_return)
             thread_yield();
+
+#ifdef VM
+        /* A process interrupted in user mode holds no kernel locks,
+           so this is where a compute-bound one, which rarely enters
+           the kernel otherwise, gets its working set sampled. */
+        if (frame->vec_no == 0x20 && frame->cs == SEL_UCSEG) {
+            intr_enable();
+            vm_sample_ws();
+            intr_disable();
+        }
+#endif
     }
 }
 
@@ -8,10 +8,62 @@
 #include <stddef.h>
 #include <string.h>
 
+uint64_t pml4_huge_splits;
+
+/* Process-context identifiers.
+ * With CR4.PCIDE set, the low 12 bits of CR3 tag every TLB entry with
+ * the address space it came from, and loading CR3 with bit 63 set keeps
+ * the entries of the incoming PCID. base_pml4 gets PCID 0; any other
+ * pml4 gets one derived from the frame it lives in, so no allocator is
+ * needed. PCID_OWNER records which pml4 last loaded each PCID: a pml4
+ * that finds its PCID used by another one, or marked stale because
+ * its page table was changed while it was not running, flushes it. */
+#define CR4_PCIDE (1 << 17)      /* CR4 bit enabling PCIDs. */
+#define CPUID_PCID (1 << 17)     /* CPUID.1:ECX bit for PCID support. */
+#define CR3_NOFLUSH (1ULL << 63) /* Keep the incoming PCID's entries. */
+#define PCID_CNT 4096
+bool pml4_use_pcid = true;
+static uint64_t *pcid_owner[PCID_CNT];
+static bool pcid_stale[PCID_CNT];
+uint64_t pml4_switches_kept, pml4_switches_flushed;
+uint64_t pml4_batch_flushes, pml4_batch_saved;
+
+static unsigned pml4_pcid(uint64_t *pml4);
+
+/* Replaces the 2 MB mapping in PDE, which covers VA, by a page
+ * table holding the same 512 translations with the same flags. */
+static bool
+pde_split(uint64_t *pde, const uint64_t va) {
+    uint64_t *pt = palloc_get_page(0);
+    if (pt == NULL)
+        return false;
+
+    uint64_t pa = PTE_ADDR(*pde);
+    uint64_t flags = *pde & (PTE_P | PTE_W | PTE_U | PTE_A | PTE_D);
+    for (unsigned i = 0; i < HUGE_PGCNT; i++)
+        pt[i] = (pa + i * PGSIZE) | flags;
+    *pde = vtop(pt) | PTE_U | PTE_W | PTE_P;
+
+    /* Drop the 2 MB TLB entry, if VA belongs to the running
+     * address space. Harmless otherwise. */
+    invlpg(va);
+    pml4_huge_splits++;
+    return true;
+}
+
+/* A walk that ends on a 2 MB mapping returns the PDE itself, whose
+ * P, W, U, A and D bits stand for every page in it, unless CREATE
+ * is set, in which case the mapping is split first. */
 static uint64_t *
 pgdir_walk(uint64_t *pdp, const uint64_t va, int create) {
     int idx = PDX(va);
     if (pdp) {
+        if (pdp[idx] & PTE_PS) {
+            if (!create)
+                return &pdp[idx];
+            if (!pde_split(&pdp[idx], va))
+                return NULL;
+        }
         uint64_t *pte = (uint64_t *)pdp[idx];
         if (!((uint64_t)pte & PTE_P)) {
             if (create) {
@@ -122,7 +174,7 @@ pgdir_for_each(uint64_t *pdp, pte_for_each_func *func, void *aux,
                unsigned pml4_index, unsigned pdp_index) {
     for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
         uint64_t *pte = ptov((uint64_t *)pdp[i]);
-        if (((uint64_t)pte) & PTE_P)
+        if ((((uint64_t)pte) & PTE_P) && !(pdp[i] & PTE_PS))
             if (!pt_for_each((uint64_t *)PTE_ADDR(pte), func, aux,
                              pml4_index, pdp_index, i))
                 return false;
@@ -168,7 +220,8 @@ static void
 pgdir_destroy(uint64_t *pdp) {
     for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
         uint64_t *pte = ptov((uint64_t *)pdp[i]);
-        if (((uint64_t)pte) & PTE_P)
+        /* Frames behind 2 MB mappings belong to the VM. */
+        if ((((uint64_t)pte) & PTE_P) && !(pdp[i] & PTE_PS))
             pt_destroy(PTE_ADDR(pte));
     }
     palloc_free_page((void *)pdp);
@@ -194,13 +247,127 @@ void pml4_destroy(uint64_t *pml4) {
     uint64_t *pdpe = ptov((uint64_t *)pml4[0]);
     if (((uint64_t)pdpe) & PTE_P)
         pdpe_destroy((void *)PTE_ADDR(pdpe));
+    /* A pml4 later made in the same page must not reuse our entries. */
+    if (pcid_owner[pml4_pcid(pml4)] == pml4)
+        pcid_owner[pml4_pcid(pml4)] = NULL;
     palloc_free_page((void *)pml4);
 }
 
+/* Returns the PCID of PML4. */
+static unsigned
+pml4_pcid(uint64_t *pml4) {
+    if (pml4 == base_pml4)
+        return 0;
+    return 1 + (vtop(pml4) >> PGBITS) % (PCID_CNT - 1);
+}
+
+/* Returns true if PML4 is the running address space. */
+static bool
+pml4_is_active(uint64_t *pml4) {
+    return (rcr3() & ~(uint64_t)PGMASK) == vtop(pml4);
+}
+
+/* Drops the TLB entries of PML4 for VA, or all of them if VA is
+ * NULL, after a change to its page table. Inside a teardown batch of
+ * the running PML4, single pages are only noted. If PML4 is not
+ * running, it can only have entries under its own PCID, which are
+ * flushed when it runs again. */
+static void
+tlb_invalidate(uint64_t *pml4, uint64_t va) {
+    if (pml4_is_active(pml4)) {
+#ifdef USERPROG
+        struct tlb_batch *b = thread_current()->tlb_batch;
+
+        if (b != NULL && b->pml4 == pml4 && va != 0) {
+            if (b->cnt < TLB_BATCH_MAX)
+                b->va[b->cnt] = va;
+            b->cnt++;
+            return;
+        }
+#endif
+        if (va != 0)
+            invlpg(va);
+        else
+            lcr3(rcr3());
+    } else if (pml4_use_pcid)
+        pcid_stale[pml4_pcid(pml4)] = true;
+}
+
+/* Turns on PCIDs if pml4_use_pcid is still set and the CPU supports
+ * them. Must be called with base_pml4 active and CR3's low bits clear. */
+void
+pml4_pcid_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+
+    if (pml4_use_pcid) {
+        cpuid(1, &eax, &ebx, &ecx, &edx);
+        pml4_use_pcid = (ecx & CPUID_PCID) != 0;
+    }
+    if (pml4_use_pcid) {
+        lcr4(rcr4() | CR4_PCIDE);
+        pcid_owner[0] = base_pml4;
+    }
+}
+
 /* Loads page directory PD into the CPU's page directory base
- * register. */
+ * register. With PCIDs, the TLB entries PML4 left there last time are
+ * kept, unless they may be out of date. */
 void pml4_activate(uint64_t *pml4) {
-    lcr3(vtop(pml4 ? pml4 : base_pml4));
+    unsigned pcid;
+
+    if (pml4 == NULL)
+        pml4 = base_pml4;
+    if (!pml4_use_pcid) {
+        lcr3(vtop(pml4));
+        return;
+    }
+    pcid = pml4_pcid(pml4);
+    if (pcid_owner[pcid] == pml4 && !pcid_stale[pcid]) {
+        pml4_switches_kept++;
+        lcr3(vtop(pml4) | pcid | CR3_NOFLUSH);
+    } else {
+        pcid_owner[pcid] = pml4;
+        pcid_stale[pcid] = false;
+        pml4_switches_flushed++;
+        lcr3(vtop(pml4) | pcid);
+    }
+}
+
+/* Starts collecting the TLB invalidations of PML4 that the current
+ * thread makes, to be done by pml4_batch_end(). Only the running
+ * address space may be batched, and the pages it unmaps meanwhile
+ * must not be touched through it. */
+void
+pml4_batch_begin(struct tlb_batch *batch, uint64_t *pml4) {
+    batch->pml4 = pml4;
+    batch->cnt = 0;
+#ifdef USERPROG
+    thread_current()->tlb_batch = batch;
+#endif
+}
+
+/* Carries out the invalidations collected in BATCH: page by page if
+ * there were few, otherwise by flushing the address space's TLB
+ * entries at once. */
+void
+pml4_batch_end(struct tlb_batch *batch) {
+#ifdef USERPROG
+    thread_current()->tlb_batch = NULL;
+#endif
+    if (batch->cnt == 0)
+        return;
+    if (!pml4_is_active(batch->pml4)) {
+        /* Switched away and back meanwhile, which flushed if needed. */
+        if (pml4_use_pcid)
+            pcid_stale[pml4_pcid(batch->pml4)] = true;
+    } else if (batch->cnt <= TLB_BATCH_MAX) {
+        for (size_t i = 0; i < batch->cnt; i++)
+            invlpg(batch->va[i]);
+    } else {
+        lcr3(rcr3());
+        pml4_batch_flushes++;
+        pml4_batch_saved += batch->cnt;
+    }
 }
 
 /* Looks up the physical address that corresponds to user virtual
@@ -213,14 +380,18 @@ pml4_get_page(uint64_t *pml4, const void *uaddr) {
 
     uint64_t *pte = pml4e_walk(pml4, (uint64_t)uaddr, 0);
 
-    if (pte && (*pte & PTE_P))
+    if (pte && (*pte & PTE_P)) {
+        if (*pte & PTE_PS)
+            return ptov(PTE_ADDR(*pte)) + ((uint64_t)uaddr & (HUGE_PGSIZE - 1));
         return ptov(PTE_ADDR(*pte)) + pg_ofs(uaddr);
+    }
     return NULL;
 }
 
 /* Adds a mapping in page map level 4 PML4 from user virtual page
  * UPAGE to the physical frame identified by kernel virtual address KPAGE.
- * UPAGE must not already be mapped. KPAGE should probably be a page obtained
+ * A mapping UPAGE already has is replaced, and a 2 MB page holding it is
+ * split first. KPAGE should probably be a page obtained
  * from the user pool with palloc_get_page().
  * If WRITABLE is true, the new page is read/write;
  * otherwise it is read-only.
@@ -234,8 +405,21 @@ bool pml4_set_page(uint64_t *pml4, void *upage, void *kpage, bool rw) {
 
     uint64_t *pte = pml4e_walk(pml4, (uint64_t)upage, 1);
 
-    if (pte)
+    if (pte && (*pte & PTE_PS)) {
+        if (!pde_split(pte, (uint64_t)upage))
+            return false;
+        pte = pml4e_walk(pml4, (uint64_t)upage, 1);
+    }
+    if (pte) {
+        /* Replacing a live mapping, e.g. making it read-only for
+           copy-on-write at fork: the old one may still be cached,
+           also under PML4's PCID if PML4 is not loaded. */
+        bool was_present = (*pte & PTE_P) != 0;
+
         *pte = vtop(kpage) | PTE_P | (rw ? PTE_W : 0) | PTE_U;
+        if (was_present)
+            tlb_invalidate(pml4, (uint64_t)upage);
+    }
     return pte != NULL;
 }
 
@@ -249,11 +433,13 @@ void pml4_clear_page(uint64_t *pml4, void *upage) {
     ASSERT(is_user_vaddr(upage));
 
     pte = pml4e_walk(pml4, (uint64_t)upage, false);
+    if (pte != NULL && (*pte & PTE_PS) && !pde_split(pte, (uint64_t)upage))
+        PANIC("pml4_clear_page: cannot split huge page");
+    pte = pml4e_walk(pml4, (uint64_t)upage, false);
 
     if (pte != NULL && (*pte & PTE_P) != 0) {
         *pte &= ~PTE_P;
-        if (rcr3() == vtop(pml4))
-            invlpg((uint64_t)upage);
+        tlb_invalidate(pml4, (uint64_t)upage);
     }
 }
 
@@ -270,14 +456,18 @@ bool pml4_is_dirty(uint64_t *pml4, const void *vpage) {
  * in PML4. */
 void pml4_set_dirty(uint64_t *pml4, const void *vpage, bool dirty) {
     uint64_t *pte = pml4e_walk(pml4, (uint64_t)vpage, false);
+    if (pte && (*pte & PTE_PS) && !dirty) {
+        if (!pde_split(pte, (uint64_t)vpage))
+            PANIC("pml4_set_dirty: cannot split huge page");
+        pte = pml4e_walk(pml4, (uint64_t)vpage, false);
+    }
     if (pte) {
         if (dirty)
             *pte |= PTE_D;
         else
             *pte &= ~(uint32_t)PTE_D;
 
-        if (rcr3() == vtop(pml4))
-            invlpg((uint64_t)vpage);
+        tlb_invalidate(pml4, (uint64_t)vpage);
     }
 }
 
@@ -291,16 +481,81 @@ bool pml4_is_accessed(uint64_t *pml4, const void *vpage) {
 }
 
 /* Sets the accessed bit to ACCESSED in the PTE for virtual page
-   VPAGE in PD. */
+   VPAGE in PD.  Clearing it in a 2 MB mapping splits the mapping
+   first, so that the other pages in it keep their bit. */
 void pml4_set_accessed(uint64_t *pml4, const void *vpage, bool accessed) {
     uint64_t *pte = pml4e_walk(pml4, (uint64_t)vpage, false);
+    if (pte && (*pte & PTE_PS) && !accessed) {
+        if (!pde_split(pte, (uint64_t)vpage))
+            PANIC("pml4_set_accessed: cannot split huge page");
+        pte = pml4e_walk(pml4, (uint64_t)vpage, false);
+    }
     if (pte) {
         if (accessed)
             *pte |= PTE_A;
         else
             *pte &= ~(uint32_t)PTE_A;
 
-        if (rcr3() == vtop(pml4))
-            invlpg((uint64_t)vpage);
+        tlb_invalidate(pml4, (uint64_t)vpage);
     }
 }
+
+/* Clears the accessed bit of the 2 MB mapping that holds UPAGE in
+ * PML4 for all of its pages at once, without splitting it.  The
+ * caller has accounted for every one of them. */
+void pml4_clear_huge_accessed(uint64_t *pml4, const void *upage) {
+    uint64_t *pde = pml4e_walk(pml4, (uint64_t)upage, false);
+
+    ASSERT(pde != NULL && (*pde & PTE_PS));
+    *pde &= ~(uint64_t)PTE_A;
+    tlb_invalidate(pml4, (uint64_t)upage);
+}
+
+/* Returns true if virtual page UPAGE in PML4 is mapped by a 2 MB
+ * page. */
+bool pml4_is_huge(uint64_t *pml4, const void *upage) {
+    uint64_t *pte = pml4e_walk(pml4, (uint64_t)upage, false);
+    return pte != NULL && (*pte & PTE_PS) != 0;
+}
+
+/* Collapses the page table behind the 2 MB aligned virtual
+ * address UPAGE in PML4 into one 2 MB mapping. This only succeeds
+ * if all 512 entries are present, share their P, W and U bits and
+ * map one 2 MB aligned physical run in order. The page table is
+ * freed; the accessed and dirty bits are merged into the PDE.
+ * Returns true if the mapping was collapsed. */
+bool pml4_promote(uint64_t *pml4, void *upage) {
+    const uint64_t keep = PTE_P | PTE_W | PTE_U;
+    uint64_t *pde, *pt;
+    uint64_t first, acc = 0;
+
+    ASSERT((uint64_t)upage % HUGE_PGSIZE == 0);
+    ASSERT(is_user_vaddr(upage));
+    ASSERT(pml4 != base_pml4);
+
+    pde = pml4e_walk(pml4, (uint64_t)upage, false);
+    if (pde == NULL || (*pde & PTE_PS))
+        return false;
+    /* The walk returned the first PTE of the table. */
+    pt = pde;
+    first = pt[0];
+    if (!(first & PTE_P) || PTE_ADDR(first) % HUGE_PGSIZE != 0)
+        return false;
+    /* Blocks tend to fill in order, so the last entry is the quick
+       reject. */
+    if (!(pt[HUGE_PGCNT - 1] & PTE_P))
+        return false;
+    for (unsigned i = 0; i < HUGE_PGCNT; i++) {
+        if (PTE_ADDR(pt[i]) != PTE_ADDR(first) + i * PGSIZE ||
+            (pt[i] & keep) != (first & keep))
+            return false;
+        acc |= pt[i] & (PTE_A | PTE_D);
+    }
+
+    uint64_t *pd = ptov(PTE_ADDR(pml4[PML4(upage)]));
+    pd = ptov(PTE_ADDR(pd[PDPE(upage)]));
+    pd[PDX(upage)] = PTE_ADDR(first) | PTE_PS | (first & keep) | acc;
+    tlb_invalidate(pml4, 0);
+    palloc_free_page(pt);
+    return true;
+}
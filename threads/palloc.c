@@ -1,6 +1,8 @@
 #include "threads/palloc.h"
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
+#include "threads/pte.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 #include <bitmap.h>
@@ -30,7 +32,11 @@
 struct pool {
     struct lock lock;        /* Mutual exclusion. */
     struct bitmap *used_map; /* Bitmap of free pages. */
+    struct bitmap *zero_map; /* Free pages known to be all zeros. */
     uint8_t *base;           /* Base of pool. */
+    size_t free_cnt;         /* Number of free pages. */
+    size_t zero_cnt;         /* Number of pages in zero_map. */
+    size_t zero_hand;        /* Where the idle thread looks next. */
 };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -42,6 +48,17 @@ static void
 init_pool(struct pool *p, void **bm_base, uint64_t start, uint64_t end);
 
 static bool page_from_pool(const struct pool *, void *page);
+static void pool_adjust_free_cnt(struct pool *, long delta);
+static bool pool_take_zeroed(struct pool *, size_t page_idx, size_t page_cnt);
+static bool pool_prezero_one(struct pool *);
+
+/* Most pages pool_prezero_one() looks at with interrupts off. */
+#define PREZERO_SCAN 256
+
+/* Statistics. */
+static long long prezero_cnt;   /* # of pages zeroed by the idle thread. */
+static long long zero_hit_cnt;  /* # of PAL_ZERO requests served pre-zeroed. */
+static long long zero_miss_cnt; /* # of PAL_ZERO requests that had to memset. */
 
 /* multiboot info */
 struct multiboot_info {
@@ -234,6 +251,11 @@ populate_pools(struct area *base_mem, struct area *ext_mem) {
             }
         }
     }
+
+    kernel_pool.free_cnt = bitmap_count(kernel_pool.used_map, 0,
+                                        bitmap_size(kernel_pool.used_map), false);
+    user_pool.free_cnt = bitmap_count(user_pool.used_map, 0,
+                                      bitmap_size(user_pool.used_map), false);
 }
 
 /* Initializes the page allocator and get the memory size */
@@ -264,9 +286,22 @@ palloc_init(void) {
 void *
 palloc_get_multiple(enum palloc_flags flags, size_t page_cnt) {
     struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+    size_t page_idx = BITMAP_ERROR;
+    bool zeroed = false;
 
     lock_acquire(&pool->lock);
-    size_t page_idx = bitmap_scan_and_flip(pool->used_map, 0, page_cnt, false);
+    /* Single zeroed pages come straight off the pre-zeroed set. */
+    if ((flags & PAL_ZERO) && page_cnt == 1 && pool->zero_cnt > 0) {
+        page_idx = bitmap_scan(pool->zero_map, 0, 1, true);
+        if (page_idx != BITMAP_ERROR)
+            bitmap_mark(pool->used_map, page_idx);
+    }
+    if (page_idx == BITMAP_ERROR)
+        page_idx = bitmap_scan_and_flip(pool->used_map, 0, page_cnt, false);
+    if (page_idx != BITMAP_ERROR) {
+        zeroed = pool_take_zeroed(pool, page_idx, page_cnt);
+        pool_adjust_free_cnt(pool, -(long)page_cnt);
+    }
     lock_release(&pool->lock);
     void *pages;
 
@@ -276,8 +311,14 @@ palloc_get_multiple(enum palloc_flags flags, size_t page_cnt) {
         pages = NULL;
 
     if (pages) {
-        if (flags & PAL_ZERO)
-            memset(pages, 0, PGSIZE * page_cnt);
+        if (flags & PAL_ZERO) {
+            if (zeroed)
+                zero_hit_cnt++;
+            else {
+                zero_miss_cnt++;
+                memset(pages, 0, PGSIZE * page_cnt);
+            }
+        }
     } else {
         if (flags & PAL_ASSERT)
             PANIC("palloc_get: out of pages");
@@ -286,6 +327,57 @@ palloc_get_multiple(enum palloc_flags flags, size_t page_cnt) {
     return pages;
 }
 
+/* Obtains the free page at slot OFS of a HUGE_PGSIZE aligned run
+   of pages, so that a 2 MB block of user memory built one page at a
+   time can end up physically contiguous and be mapped as a whole.
+   If RUN is non-null, it is the run's start and only the page at
+   RUN + OFS * PGSIZE will do.  Otherwise the page comes from the
+   highest run that is entirely free, since single-page allocations
+   fill the pool from the bottom and reach it last.  Returns NULL if
+   there is no such page.  FLAGS are interpreted as for
+   palloc_get_multiple(). */
+void *
+palloc_get_huge_page(enum palloc_flags flags, void *run, size_t ofs) {
+    struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+    size_t cnt = bitmap_size(pool->used_map);
+    size_t first = (HUGE_PGCNT - pg_no(pool->base) % HUGE_PGCNT) % HUGE_PGCNT;
+    size_t page_idx = BITMAP_ERROR;
+    bool zeroed = false;
+    void *page;
+
+    ASSERT(ofs < HUGE_PGCNT);
+
+    lock_acquire(&pool->lock);
+    if (run != NULL) {
+        if (page_from_pool(pool, run) &&
+            pg_no(run) - pg_no(pool->base) + ofs < cnt &&
+            !bitmap_test(pool->used_map, pg_no(run) - pg_no(pool->base) + ofs))
+            page_idx = pg_no(run) - pg_no(pool->base) + ofs;
+    } else if (first + HUGE_PGCNT <= cnt) {
+        for (size_t idx = first + (cnt - first) / HUGE_PGCNT * HUGE_PGCNT;
+             idx > first;) {
+            idx -= HUGE_PGCNT;
+            if (bitmap_none(pool->used_map, idx, HUGE_PGCNT)) {
+                page_idx = idx + ofs;
+                break;
+            }
+        }
+    }
+    if (page_idx != BITMAP_ERROR) {
+        bitmap_mark(pool->used_map, page_idx);
+        zeroed = pool_take_zeroed(pool, page_idx, 1);
+        pool_adjust_free_cnt(pool, -1);
+    }
+    lock_release(&pool->lock);
+
+    if (page_idx == BITMAP_ERROR)
+        return NULL;
+    page = pool->base + PGSIZE * page_idx;
+    if ((flags & PAL_ZERO) && !zeroed)
+        memset(page, 0, PGSIZE);
+    return page;
+}
+
 /* Obtains a single free page and returns its kernel virtual
    address.
    If PAL_USER is set, the page is obtained from the user pool,
@@ -321,6 +413,21 @@ void palloc_free_multiple(void *pages, size_t page_cnt) {
 #endif
     ASSERT(bitmap_all(pool->used_map, page_idx, page_cnt));
     bitmap_set_multiple(pool->used_map, page_idx, page_cnt, false);
+    pool_adjust_free_cnt(pool, page_cnt);
+}
+
+/* Returns the number of free pages in the user pool if PAL_USER is set
+   in FLAGS, otherwise in the kernel pool. */
+size_t
+palloc_free_cnt(enum palloc_flags flags) {
+    return (flags & PAL_USER ? &user_pool : &kernel_pool)->free_cnt;
+}
+
+/* Returns the number of pages in the user pool if PAL_USER is set in
+   FLAGS, otherwise in the kernel pool. */
+size_t
+palloc_pool_size(enum palloc_flags flags) {
+    return bitmap_size((flags & PAL_USER ? &user_pool : &kernel_pool)->used_map);
 }
 
 /* Frees the page at PAGE. */
@@ -328,6 +435,29 @@ void palloc_free_page(void *page) {
     palloc_free_multiple(page, 1);
 }
 
+/* Zeros up to MAX free pages ahead of time, so that later PAL_ZERO
+   requests can skip the memset.  Called by the idle thread, which
+   must never hold a lock: it gives up instead of waiting for a busy
+   pool.  Returns the number of pages zeroed. */
+size_t
+palloc_prezero(size_t max) {
+    size_t cnt = 0;
+
+    while (cnt < max && pool_prezero_one(&user_pool))
+        cnt++;
+    while (cnt < max && pool_prezero_one(&kernel_pool))
+        cnt++;
+    return cnt;
+}
+
+/* Prints pre-zeroing statistics. */
+void
+palloc_print_stats(void) {
+    printf("Palloc: %lld pages pre-zeroed, %lld zeroed requests hit, "
+           "%lld missed\n",
+           prezero_cnt, zero_hit_cnt, zero_miss_cnt);
+}
+
 /* Initializes pool P as starting at START and ending at END */
 static void
 init_pool(struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
@@ -339,12 +469,91 @@ init_pool(struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
 
     lock_init(&p->lock);
     p->used_map = bitmap_create_in_buf(pgcnt, *bm_base, bm_pages);
+    p->zero_map = bitmap_create_in_buf(pgcnt, *bm_base + bm_pages, bm_pages);
     p->base = (void *)start;
+    p->zero_cnt = 0;
+    p->zero_hand = pgcnt;
 
     // Mark all to unusable.
     bitmap_set_all(p->used_map, true);
+    bitmap_set_all(p->zero_map, false);
+
+    *bm_base += 2 * bm_pages;
+}
+
+/* Adds DELTA to POOL's free page count. Pages are freed without the
+   pool lock, sometimes with interrupts off, so the update is made atomic
+   by disabling interrupts instead. */
+static void
+pool_adjust_free_cnt(struct pool *pool, long delta) {
+    enum intr_level old_level = intr_disable();
+    pool->free_cnt += delta;
+    intr_set_level(old_level);
+}
 
-    *bm_base += bm_pages;
+/* Takes the PAGE_CNT pages starting at PAGE_IDX, just allocated,
+   out of POOL's pre-zeroed set.  Returns true if all of them were
+   zeroed already.  Must hold the pool lock. */
+static bool
+pool_take_zeroed(struct pool *pool, size_t page_idx, size_t page_cnt) {
+    size_t zeroed = bitmap_count(pool->zero_map, page_idx, page_cnt, true);
+
+    if (zeroed > 0) {
+        /* pool_prezero_one() counts pages back in without the lock. */
+        enum intr_level old_level = intr_disable();
+
+        bitmap_set_multiple(pool->zero_map, page_idx, page_cnt, false);
+        pool->zero_cnt -= zeroed;
+        intr_set_level(old_level);
+    }
+    return zeroed == page_cnt;
+}
+
+/* Zeros one free page of POOL that is not known to be zero yet.
+   The hand walks down from the top of the pool, so that the
+   first-fit scans in palloc_get_multiple() reach the zeroed pages
+   last.  The idle thread calls this and must not take the pool
+   lock: if it were preempted holding it, a waiter would donate its
+   priority to a thread that is in no ready queue.  So the page is
+   claimed with interrupts off, and only while no allocator holds
+   the lock and might be halfway through picking it; it is zeroed
+   with interrupts on and no lock held; and it goes back, like a
+   freed page, with interrupts off.  Returns false if there is
+   nothing to do or the pool is busy. */
+static bool
+pool_prezero_one(struct pool *pool) {
+    size_t cnt = bitmap_size(pool->used_map);
+    size_t idx = BITMAP_ERROR;
+    enum intr_level old_level;
+
+    old_level = intr_disable();
+    if (pool->zero_cnt < pool->free_cnt && pool->lock.holder == NULL) {
+        for (size_t n = 0; n < cnt && n < PREZERO_SCAN; n++) {
+            size_t i = pool->zero_hand = (pool->zero_hand == 0 ? cnt : pool->zero_hand) - 1;
+
+            if (!bitmap_test(pool->used_map, i) &&
+                !bitmap_test(pool->zero_map, i)) {
+                bitmap_mark(pool->used_map, i);
+                pool->free_cnt--;
+                idx = i;
+                break;
+            }
+        }
+    }
+    intr_set_level(old_level);
+    if (idx == BITMAP_ERROR)
+        return false;
+
+    memset(pool->base + PGSIZE * idx, 0, PGSIZE);
+
+    old_level = intr_disable();
+    bitmap_mark(pool->zero_map, idx);
+    pool->zero_cnt++;
+    bitmap_reset(pool->used_map, idx);
+    pool->free_cnt++;
+    prezero_cnt++;
+    intr_set_level(old_level);
+    return true;
 }
 
 /* Returns true if PAGE was allocated from POOL,
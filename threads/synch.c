@@ -182,7 +182,7 @@ void lock_acquire(struct lock *lock) {
     ASSERT(!intr_context());
     ASSERT(!lock_held_by_current_thread(lock));
 
-    if (lock->holder) {
+    if (lock->holder && !thread_mlfqs) {
         curr->wait_on_lock = lock;
         list_insert_ordered(&lock->holder->donations, &thread_current()->d_elem, compare_priority, NULL);
         while (curr && lock_t && lock_t->holder) {
@@ -227,6 +227,11 @@ void lock_release(struct lock *lock) {
     ASSERT(lock_held_by_current_thread(lock));
     struct thread *curr = thread_current();
 
+    if (thread_mlfqs) {
+        lock->holder = NULL;
+        sema_up(&lock->semaphore);
+        return;
+    }
     curr->priority = curr->origin_priority;
     for (struct list_elem *e = list_begin(&curr->donations); e != list_end(&curr->donations);) {
         struct thread *t = list_entry(e, struct thread, d_elem);
@@ -345,5 +350,5 @@ bool compare_cond_priority(const struct list_elem *a, const struct list_elem *b,
 
 void donate_priority(struct lock *lock, struct thread *curr) {
     if (lock->holder->priority < curr->priority)
-        lock->holder->priority = curr->priority;
+        thread_change_priority(lock->holder, curr->priority);
 }
@@ -6,6 +6,7 @@
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
 #include <debug.h>
 #include <random.h>
 #include <stddef.h>
@@ -24,10 +25,31 @@
    Do not modify this value. */
 #define THREAD_BASIC 0xd42df210
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
-static struct list sleep_list;
+/* Processes in THREAD_READY state, that is, processes that are
+   ready to run but not actually running.  There is one FIFO queue
+   per priority, and bit P of ready_bitmap is set iff
+   ready_queues[P] is non-empty, so that the highest ready priority
+   is a single bit scan. */
+static struct list ready_queues[PRI_MAX + 1];
+static uint64_t ready_bitmap;
+static size_t ready_cnt; /* # of threads in all ready_queues. */
+
+/* Sleeping threads, in a hierarchical timing wheel.  Level L has
+   WHEEL_SIZE slots of WHEEL_SIZE^L ticks each.  A thread due within
+   WHEEL_SIZE ticks sits in the level 0 slot for its wake tick; one
+   due later sits in a coarser slot and is moved down a level
+   ("cascaded") when the finer levels wrap around to it.  Sleeping
+   is O(1), and so is a tick on which nobody wakes up. */
+#define WHEEL_BITS 6
+#define WHEEL_SIZE (1 << WHEEL_BITS)
+#define WHEEL_LEVELS 4
+#define WHEEL_SPAN (1LL << (WHEEL_BITS * WHEEL_LEVELS)) /* Ticks covered. */
+static struct list sleep_wheel[WHEEL_LEVELS][WHEEL_SIZE];
+static int64_t wheel_ticks; /* Last tick the wheel was advanced to. */
+static size_t sleep_cnt;    /* # of threads in the wheel. */
+
+/* List of all threads but the dying ones, for the MLFQS to update. */
+static struct list all_list;
 
 /* Idle thread. */
 static struct thread *idle_thread;
@@ -48,6 +70,7 @@ static long long user_ticks;   /* # of timer ticks in user programs. */
 
 /* Scheduling. */
 #define TIME_SLICE 4          /* # of timer ticks to give each thread. */
+#define PREZERO_BATCH 16      /* # of pages idle() zeros per wakeup. */
 static unsigned thread_ticks; /* # of timer ticks since last yield. */
 
 /* If false (default), use round-robin scheduler.
@@ -55,7 +78,22 @@ static unsigned thread_ticks; /* # of timer ticks since last yield. */
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* Multi-level feedback queue scheduler. */
+#define NICE_MIN -20
+#define NICE_MAX 20
+#define MLFQS_PRI_TICKS 4 /* # of timer ticks between priority updates. */
+static fixed_t load_avg;  /* Estimated # of threads ready to run. */
+
 static void kernel_thread(thread_func *, void *aux);
+static void ready_push(struct thread *t);
+static void ready_remove(struct thread *t);
+static int ready_max_priority(void);
+static void wheel_insert(struct thread *t, int64_t now);
+static void wheel_cascade(int level, int slot);
+static void mlfqs_tick(struct thread *t);
+static void mlfqs_update_priority(struct thread *t, void *aux);
+static void mlfqs_update_recent_cpu(struct thread *t, void *aux);
+static void thread_foreach(void (*func)(struct thread *, void *), void *aux);
 
 static void idle(void *aux UNUSED);
 static struct thread *next_thread_to_run(void);
@@ -107,8 +145,12 @@ void thread_init(void) {
 
     /* Init the globla thread context */
     lock_init(&tid_lock);
-    list_init(&ready_list);
-    list_init(&sleep_list);
+    for (int i = PRI_MIN; i <= PRI_MAX; i++)
+        list_init(&ready_queues[i]);
+    for (int level = 0; level < WHEEL_LEVELS; level++)
+        for (int i = 0; i < WHEEL_SIZE; i++)
+            list_init(&sleep_wheel[level][i]);
+    list_init(&all_list);
     list_init(&destruction_req);
 
     /* Set up a thread structure for the running thread. */
@@ -148,11 +190,30 @@ void thread_tick(void) {
     else
         kernel_ticks++;
 
+    if (thread_mlfqs)
+        mlfqs_tick(t);
+
     /* Enforce preemption. */
     if (++thread_ticks >= TIME_SLICE)
         intr_yield_on_return();
 }
 
+/* Accounts a timer tick that the CPU spent idle without a timer
+   interrupt.  Called by the timer interrupt handler when it catches
+   up after tickless idle. */
+void thread_tick_idle(void) {
+    idle_ticks++;
+    if (thread_mlfqs)
+        mlfqs_tick(idle_thread);
+}
+
+/* Returns true if the timer interrupted the idle thread and no other
+   thread is ready to run. */
+bool thread_idle_alone(void) {
+    ASSERT(intr_get_level() == INTR_OFF);
+    return thread_current() == idle_thread && ready_bitmap == 0;
+}
+
 /* Prints thread statistics. */
 void thread_print_stats(void) {
     printf("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
@@ -191,6 +252,11 @@ tid_t thread_create(const char *name, int priority, thread_func *function, void
     /* Initialize thread. */
     init_thread(t, name, priority);
     tid = t->tid = allocate_tid();
+    if (thread_mlfqs) {
+        t->nice = curr->nice;
+        t->recent_cpu = curr->recent_cpu;
+        mlfqs_update_priority(t, NULL);
+    }
     list_push_back(&curr->child_list, &t->c_elem);
 
     /* Call the kernel_thread if it scheduled.
@@ -222,7 +288,7 @@ void imm_preempt(struct thread *t) {
     t->status = THREAD_RUNNING;
     curr->status = THREAD_READY;
     thread_ticks = 0;
-    list_insert_ordered(&ready_list, &curr->elem, compare_priority, NULL);
+    ready_push(curr);
     thread_launch(t);
 
     intr_set_level(old_level);
@@ -256,8 +322,7 @@ void thread_unblock(struct thread *t) {
 
     old_level = intr_disable();
     ASSERT(t->status == THREAD_BLOCKED);
-    // list_push_back(&ready_list, &t->elem);
-    list_insert_ordered(&ready_list, &t->elem, compare_priority, NULL);
+    ready_push(t);
     t->status = THREAD_READY;
     intr_set_level(old_level);
 }
@@ -303,6 +368,7 @@ void thread_exit(void) {
     /* Just set our status to dying and schedule another process.
        We will be destroyed during the call to schedule_tail(). */
     intr_disable();
+    list_remove(&thread_current()->all_elem);
     do_schedule(THREAD_DYING);
     NOT_REACHED();
 }
@@ -317,7 +383,7 @@ void thread_yield(void) {
 
     old_level = intr_disable();
     if (curr != idle_thread)
-        list_insert_ordered(&ready_list, &curr->elem, compare_priority, NULL);
+        ready_push(curr);
     do_schedule(THREAD_READY);
     intr_set_level(old_level);
 }
@@ -331,32 +397,114 @@ void thread_sleep(int64_t wake_tick) {
 
     old_level = intr_disable();
     if (curr != idle_thread)
-        list_push_back(&sleep_list, &curr->elem);
+        wheel_insert(curr, wheel_ticks + 1);
     do_schedule(THREAD_BLOCKED);
     intr_set_level(old_level);
 }
 
+/* Advances the timing wheel to TICKS, waking up every thread whose
+   wake_tick has come. */
 void thread_awake(int64_t ticks) {
-    struct thread *awake;
-    struct list_elem *e;
-
     ASSERT(intr_context()); /* 너 인터럽트 context이니? */
 
-    for (e = list_begin(&sleep_list); e != list_end(&sleep_list);) {
-        awake = list_entry(e, struct thread, elem);
-        if (awake->wake_tick <= ticks) {
-            e = list_remove(e);
-            thread_unblock(awake);
-        } else
-            e = list_next(e);
+    if (sleep_cnt == 0) {
+        wheel_ticks = ticks;
+        return;
+    }
+
+    while (wheel_ticks < ticks) {
+        struct list *slot;
+        int64_t now = ++wheel_ticks;
+        int level;
+
+        /* On wrap-around of each finer level, pull the next slot of
+           the coarser one down. */
+        for (level = 1; level < WHEEL_LEVELS; level++) {
+            if (now & ((1LL << (WHEEL_BITS * level)) - 1))
+                break;
+            wheel_cascade(level, (now >> (WHEEL_BITS * level)) & (WHEEL_SIZE - 1));
+        }
+
+        slot = &sleep_wheel[0][now & (WHEEL_SIZE - 1)];
+        while (!list_empty(slot)) {
+            struct thread *t = list_entry(list_pop_front(slot), struct thread, elem);
+
+            sleep_cnt--;
+            thread_unblock(t);
+        }
+    }
+}
+
+/* Returns the number of ticks, at most MAX, until the timing wheel
+   next has work to do: a sleeper to wake up or a slot to cascade. */
+int thread_next_wakeup(int max) {
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    if (sleep_cnt == 0)
+        return max;
+    for (int i = 1; i < max; i++) {
+        int64_t tick = wheel_ticks + i;
+
+        if ((tick & (WHEEL_SIZE - 1)) == 0 || !list_empty(&sleep_wheel[0][tick & (WHEEL_SIZE - 1)]))
+            return i;
+    }
+    return max;
+}
+
+/* Puts sleeping thread T in the wheel slot for its wake_tick,
+   where NOW is the first tick the wheel has yet to process. */
+static void
+wheel_insert(struct thread *t, int64_t now) {
+    int64_t wake = t->wake_tick;
+    int64_t delta;
+    int level;
+
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    if (wake < now)
+        wake = now;
+    delta = wake - now;
+    /* Beyond the wheel's span, park in the farthest slot; it is
+       re-inserted from there when cascaded. */
+    if (delta >= WHEEL_SPAN)
+        wake = now + WHEEL_SPAN - 1;
+
+    for (level = 0; level < WHEEL_LEVELS - 1; level++)
+        if (delta < 1LL << (WHEEL_BITS * (level + 1)))
+            break;
+
+    list_push_back(&sleep_wheel[level][(wake >> (WHEEL_BITS * level)) & (WHEEL_SIZE - 1)],
+                   &t->elem);
+    sleep_cnt++;
+}
+
+/* Re-inserts every thread in SLOT of LEVEL, moving each to a finer
+   level now that its wake_tick is closer.  Called before the level
+   0 slot for wheel_ticks is processed. */
+static void
+wheel_cascade(int level, int slot) {
+    struct list *list = &sleep_wheel[level][slot];
+    struct list pending;
+
+    list_init(&pending);
+    while (!list_empty(list))
+        list_push_back(&pending, list_pop_front(list));
+    while (!list_empty(&pending)) {
+        sleep_cnt--;
+        wheel_insert(list_entry(list_pop_front(&pending), struct thread, elem), wheel_ticks);
     }
 }
 
 /* Sets the current thread's priority to NEW_PRIORITY. */
 void thread_set_priority(int new_priority) {
-    struct thread *next = next_thread_to_run();
     struct thread *curr = thread_current();
+    enum intr_level old_level;
+
+    /* The MLFQS sets priorities by itself. */
+    if (thread_mlfqs)
+        return;
 
+    old_level = intr_disable();
     curr->priority = new_priority;
     curr->origin_priority = new_priority;
 
@@ -365,9 +513,24 @@ void thread_set_priority(int new_priority) {
         struct thread *priory_thread = list_entry(list_begin(&curr->donations), struct thread, d_elem);
         donate_priority(priory_thread->wait_on_lock, priory_thread);
     }
+    ready_list_preempt();
+    intr_set_level(old_level);
+}
 
-    if (next->priority > new_priority)
-        imm_preempt(next);
+/* Changes T's priority to PRIORITY, moving T to the matching ready
+   queue if it is ready to run.  The idle thread is never in a ready
+   queue, even when preempted. */
+void thread_change_priority(struct thread *t, int priority) {
+    enum intr_level old_level = intr_disable();
+
+    if (t->status == THREAD_READY && t != idle_thread &&
+        t->priority != priority) {
+        ready_remove(t);
+        t->priority = priority;
+        ready_push(t);
+    } else
+        t->priority = priority;
+    intr_set_level(old_level);
 }
 
 /* Returns the current thread's priority. */
@@ -375,27 +538,108 @@ int thread_get_priority(void) {
     return thread_current()->priority;
 }
 
-/* Sets the current thread's nice value to NICE. */
-void thread_set_nice(int nice UNUSED) {
-    /* TODO: Your implementation goes here */
+/* Sets the current thread's nice value to NICE, recomputes its
+   priority, and yields if it no longer has the highest one. */
+void thread_set_nice(int nice) {
+    enum intr_level old_level;
+
+    if (nice < NICE_MIN)
+        nice = NICE_MIN;
+    if (nice > NICE_MAX)
+        nice = NICE_MAX;
+
+    old_level = intr_disable();
+    thread_current()->nice = nice;
+    mlfqs_update_priority(thread_current(), NULL);
+    ready_list_preempt();
+    intr_set_level(old_level);
 }
 
 /* Returns the current thread's nice value. */
 int thread_get_nice(void) {
-    /* TODO: Your implementation goes here */
-    return 0;
+    return thread_current()->nice;
 }
 
 /* Returns 100 times the system load average. */
 int thread_get_load_avg(void) {
-    /* TODO: Your implementation goes here */
-    return 0;
+    enum intr_level old_level = intr_disable();
+    int load = fp_round(load_avg * 100);
+
+    intr_set_level(old_level);
+    return load;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int thread_get_recent_cpu(void) {
-    /* TODO: Your implementation goes here */
-    return 0;
+    enum intr_level old_level = intr_disable();
+    int recent = fp_round(thread_current()->recent_cpu * 100);
+
+    intr_set_level(old_level);
+    return recent;
+}
+
+/* Calls FUNC on every thread with AUX. Interrupts must be off. */
+static void
+thread_foreach(void (*func)(struct thread *, void *), void *aux) {
+    struct list_elem *e;
+
+    ASSERT(intr_get_level() == INTR_OFF);
+    for (e = list_begin(&all_list); e != list_end(&all_list); e = list_next(e))
+        func(list_entry(e, struct thread, all_elem), aux);
+}
+
+/* Sets T's priority to PRI_MAX - recent_cpu / 4 - nice * 2, within
+   [PRI_MIN, PRI_MAX]. */
+static void
+mlfqs_update_priority(struct thread *t, void *aux UNUSED) {
+    int priority;
+
+    if (t == idle_thread)
+        return;
+    priority = PRI_MAX - fp_to_int(t->recent_cpu / 4) - t->nice * 2;
+    if (priority < PRI_MIN)
+        priority = PRI_MIN;
+    if (priority > PRI_MAX)
+        priority = PRI_MAX;
+    thread_change_priority(t, priority);
+}
+
+/* Decays T's recent_cpu by 2 * load_avg / (2 * load_avg + 1) and
+   adds its nice value. */
+static void
+mlfqs_update_recent_cpu(struct thread *t, void *aux UNUSED) {
+    fixed_t twice_load = load_avg * 2;
+
+    if (t == idle_thread)
+        return;
+    t->recent_cpu = fp_add_int(
+        fp_mul(fp_div(twice_load, fp_add_int(twice_load, 1)), t->recent_cpu),
+        t->nice);
+}
+
+/* Does the MLFQS bookkeeping for a timer tick in which T ran: charges
+   T for it, updates load_avg and every recent_cpu once a second, and
+   recomputes every priority each MLFQS_PRI_TICKS ticks, preempting T
+   if a ready thread now outranks it. */
+static void
+mlfqs_tick(struct thread *t) {
+    int64_t ticks = timer_ticks();
+
+    if (t != idle_thread)
+        t->recent_cpu = fp_add_int(t->recent_cpu, 1);
+
+    if (ticks % TIMER_FREQ == 0) {
+        int ready = ready_cnt + (t != idle_thread);
+
+        load_avg = (load_avg * 59 + fp_from_int(ready)) / 60;
+        thread_foreach(mlfqs_update_recent_cpu, NULL);
+    }
+
+    if (ticks % MLFQS_PRI_TICKS == 0) {
+        thread_foreach(mlfqs_update_priority, NULL);
+        if (ready_max_priority() > t->priority)
+            intr_yield_on_return();
+    }
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
@@ -415,9 +659,16 @@ idle(void *idle_started_ UNUSED) {
     sema_up(idle_started);
 
     for (;;) {
+        /* Zero a few free pages for later PAL_ZERO requests, unless
+           an interrupt has just made someone ready to run. */
+        if (ready_bitmap == 0)
+            palloc_prezero(PREZERO_BATCH);
+
         /* Let someone else run. */
         intr_disable();
         thread_block();
+        if (timer_tickless)
+            timer_idle_enter();
 
         /* Re-enable interrupts and wait for the next one.
 
@@ -432,6 +683,8 @@ idle(void *idle_started_ UNUSED) {
            See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a]
            7.11.1 "HLT Instruction". */
         asm volatile("sti; hlt" : : : "memory");
+        if (timer_tickless)
+            timer_idle_exit();
     }
 }
 
@@ -449,6 +702,8 @@ kernel_thread(thread_func *function, void *aux) {
    NAME. */
 static void
 init_thread(struct thread *t, const char *name, int priority) {
+    enum intr_level old_level;
+
     ASSERT(t != NULL);
     ASSERT(PRI_MIN <= priority && priority <= PRI_MAX);
     ASSERT(name != NULL);
@@ -467,6 +722,10 @@ init_thread(struct thread *t, const char *name, int priority) {
     list_init(&t->fd_list);
     list_init(&t->child_list);
 
+    old_level = intr_disable();
+    list_push_back(&all_list, &t->all_elem);
+    intr_set_level(old_level);
+
     sema_init(&t->fork_sema, 0);
     sema_init(&t->wait_sema, 0);
     sema_init(&t->exit_sema, 0);
@@ -479,10 +738,43 @@ init_thread(struct thread *t, const char *name, int priority) {
    idle_thread. */
 static struct thread *
 next_thread_to_run(void) {
-    if (list_empty(&ready_list))
+    struct thread *t;
+    int priority = ready_max_priority();
+
+    if (priority < 0)
         return idle_thread;
-    else
-        return list_entry(list_pop_front(&ready_list), struct thread, elem);
+    t = list_entry(list_front(&ready_queues[priority]), struct thread, elem);
+    ready_remove(t);
+    return t;
+}
+
+/* Appends T to the ready queue for its priority. */
+static void
+ready_push(struct thread *t) {
+    ASSERT(intr_get_level() == INTR_OFF);
+    ASSERT(t->priority >= PRI_MIN && t->priority <= PRI_MAX);
+
+    list_push_back(&ready_queues[t->priority], &t->elem);
+    ready_bitmap |= 1ULL << t->priority;
+    ready_cnt++;
+}
+
+/* Removes T from its ready queue. */
+static void
+ready_remove(struct thread *t) {
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    list_remove(&t->elem);
+    if (list_empty(&ready_queues[t->priority]))
+        ready_bitmap &= ~(1ULL << t->priority);
+    ready_cnt--;
+}
+
+/* Returns the highest priority with a ready thread, or -1 if no
+   thread is ready. */
+static int
+ready_max_priority(void) {
+    return ready_bitmap ? 63 - __builtin_clzll(ready_bitmap) : -1;
 }
 
 /* Use iretq to launch the thread */
@@ -656,8 +948,6 @@ bool compare_priority(const struct list_elem *a, const struct list_elem *b, void
 }
 
 void ready_list_preempt() {
-    struct thread *t = list_entry(list_begin(&ready_list), struct thread, elem);
-
-    if (!intr_context() && thread_current()->priority < t->priority)
+    if (!intr_context() && thread_current()->priority < ready_max_priority())
         thread_yield();
 }
\ No newline at end of file
@@ -23,6 +23,7 @@
 #include <string.h>
 #ifdef VM
 #include "vm/vm.h"
+#include "vm/vma.h"
 #endif
 
 static void process_cleanup(void);
@@ -70,6 +71,7 @@ initd(void *f_name)
 {
 #ifdef VM
     supplemental_page_table_init(&thread_current()->spt);
+    thread_current()->stack_limit = STACK_MAX;
 #endif
 
     process_init();
@@ -162,7 +164,10 @@ __do_fork(void *aux)
     process_activate(current);
 #ifdef VM
     current->parent_pml4 = parent->pml4;
+    current->stack_bottom = parent->stack_bottom;
+    current->stack_limit = parent->stack_limit;
     supplemental_page_table_init(&current->spt);
+    vm_prefetch_drain(parent);
     if (!supplemental_page_table_copy(&current->spt, &parent->spt))
     {
         goto error;
@@ -340,6 +345,10 @@ void process_exit(void)
      * TODO: project2/process_termination.html).
      * TODO: We recommend you to implement process resource cleanup here. */
 
+#ifdef VM
+    if (curr->pml4 != NULL)
+        vm_mstat_record();
+#endif
     process_cleanup();
 
     if (!list_empty(&curr->fd_list))
@@ -770,13 +779,14 @@ lazy_load_segment(struct page *page, void *aux)
     /* TODO: Load the segment from the file */
     /* TODO: This called when the first page fault occurs on address VA. */
     /* TODO: VA is available when calling this function. */
-    struct load_info *info = (struct load_info *)aux;
+    struct vma *vma = aux;
+    size_t page_read_bytes = vma_page_read_bytes(vma, page->va);
     uint8_t *kpage = page->frame->kva;
     if (kpage == NULL)
         return false;
-    file_seek(info->file, info->offset);
     /* Load this page. */
-    if (file_read(info->file, kpage, info->page_read_bytes) != (int)info->page_read_bytes)
+    if (file_read_at(vma->file, kpage, page_read_bytes,
+                     vma_page_offset(vma, page->va)) != (int)page_read_bytes)
         return false;
 
     return true;
@@ -804,33 +814,27 @@ load_segment(struct file *file, off_t ofs, uint8_t *upage,
     ASSERT(pg_ofs(upage) == 0);
     ASSERT(ofs % PGSIZE == 0);
 
-    while (read_bytes > 0 || zero_bytes > 0)
+    /* The segment becomes one region, with its own handle on FILE; its
+     * pages are loaded, or mapped to the zero page past READ_BYTES, as
+     * they are touched. Read-only segments are backed by FILE itself, so
+     * that their frames are shared by (inode, offset) across processes
+     * and simply dropped on eviction. */
+    struct file *segment_file = file_reopen(file);
+    if (!segment_file)
+        return false;
+    struct vma *vma = vma_create(upage, read_bytes + zero_bytes,
+                                 writable ? VM_ANON : VM_FILE | VM_TEXT,
+                                 writable, segment_file, ofs, read_bytes,
+                                 lazy_load_segment);
+    if (!vma)
     {
-        /* Do calculate how to fill this page.
-         * We will read PAGE_READ_BYTES bytes from FILE
-         * and zero the final PAGE_ZERO_BYTES bytes. */
-        size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-        size_t page_zero_bytes = PGSIZE - page_read_bytes;
-
-        /* TODO: Set up aux to pass information to the lazy_load_segment. */
-        struct load_info *info = malloc(sizeof *info);
-        if (!info)
-            return false;
-        info->file = file;
-        info->page_read_bytes = page_read_bytes;
-        info->page_zero_bytes = page_zero_bytes;
-        info->offset = ofs;
-        if (!vm_alloc_page_with_initializer(VM_ANON, upage, writable, lazy_load_segment, info))
-        {
-            // free(info);
-            return false;
-        }
-
-        /* Advance. */
-        read_bytes -= page_read_bytes;
-        zero_bytes -= page_zero_bytes;
-        upage += PGSIZE;
-        ofs += page_read_bytes;
+        file_close(segment_file);
+        return false;
+    }
+    if (!spt_insert_vma(&thread_current()->spt, vma))
+    {
+        vma_destroy(vma);
+        return false;
     }
     return true;
 }
@@ -851,6 +855,7 @@ setup_stack(struct intr_frame *if_)
         return false;
     if (!vm_claim_page(stack_bottom))
         return false;
+    thread_current()->stack_bottom = stack_bottom;
     if_->rsp = USER_STACK;
     return true;
 }
@@ -14,6 +14,11 @@
 #include "userprog/process.h"
 #include <stdio.h>
 #include <syscall-nr.h>
+#ifdef VM
+#include "vm/vma.h"
+#endif
+#include <faultstat.h>
+#include <mstat.h>
 
 void syscall_entry(void);
 void syscall_handler(struct intr_frame *);
@@ -36,6 +41,11 @@ void check_buffer(uint64_t *buffer);
 int dup2(int oldfd, int newfd);
 void *mmap(void *addr, size_t length, int writable, int fd, off_t offset);
 void munmap(void *addr);
+int mstat(struct mstat *st);
+int madvise(void *addr, size_t length, int advice);
+int msync(void *addr, size_t length);
+int stacklimit(size_t size);
+int faultstat(struct faultstat *fs);
 /* lock for access file_sys code */
 struct lock file_lock;
 
@@ -73,6 +83,9 @@ void syscall_handler(struct intr_frame *f UNUSED)
     // TODO: Your implementation goes here.
     struct thread *curr = thread_current();
     curr->user_rsp = f->rsp;
+#ifdef VM
+    vm_sample_ws();
+#endif
     switch (syscall_num)
     {
     case SYS_HALT:
@@ -126,6 +139,21 @@ void syscall_handler(struct intr_frame *f UNUSED)
     case SYS_MUNMAP:
         munmap(f->R.rdi);
         break;
+    case SYS_MSTAT:
+        f->R.rax = mstat((struct mstat *)f->R.rdi);
+        break;
+    case SYS_MADVISE:
+        f->R.rax = madvise((void *)f->R.rdi, f->R.rsi, f->R.rdx);
+        break;
+    case SYS_MSYNC:
+        f->R.rax = msync((void *)f->R.rdi, f->R.rsi);
+        break;
+    case SYS_STACKLIMIT:
+        f->R.rax = stacklimit(f->R.rdi);
+        break;
+    case SYS_FAULTSTAT:
+        f->R.rax = faultstat((struct faultstat *)f->R.rdi);
+        break;
     default:
         break;
     }
@@ -133,7 +161,10 @@ void syscall_handler(struct intr_frame *f UNUSED)
 
 void check_addr(uint64_t *ptr)
 {
-    if (ptr == NULL || is_kernel_vaddr(ptr) || !spt_find_page(&thread_current()->spt, ptr))
+    struct supplemental_page_table *spt = &thread_current()->spt;
+
+    if (ptr == NULL || is_kernel_vaddr(ptr) ||
+        (!spt_find_page(spt, ptr) && !spt_find_vma(spt, ptr)))
         exit(-1);
 }
 
@@ -420,8 +451,14 @@ int dup2(int oldfd, int newfd)
 void check_buffer(uint64_t *buffer)
 {
     struct page *p = spt_find_page(&thread_current()->spt, buffer);
+    struct vma *vma;
     if (!p)
-        exit(-1);
+    {
+        vma = spt_find_vma(&thread_current()->spt, buffer);
+        if (!vma || !vma->writable)
+            exit(-1);
+        return;
+    }
     if (!p->writable && !p->original_writable)
         exit(-1);
 }
@@ -445,4 +482,66 @@ void *mmap(void *addr, size_t length, int writable, int fd, off_t offset)
 void munmap(void *addr)
 {
     do_munmap(addr);
-}
\ No newline at end of file
+}
+
+/* Copies the memory use of this process to ST. */
+int mstat(struct mstat *st)
+{
+#ifdef VM
+    struct mstat kst;
+
+    check_addr((uint64_t *)st);
+    check_buffer((uint64_t *)st);
+    check_buffer((uint64_t *)((uint8_t *)st + sizeof *st - 1));
+    vm_mstat(&kst);
+    memcpy(st, &kst, sizeof kst);
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+/* Gives advice about the use of the LENGTH bytes at ADDR. */
+int madvise(void *addr, size_t length, int advice)
+{
+#ifdef VM
+    return vm_madvise(addr, length, advice);
+#else
+    return -1;
+#endif
+}
+
+/* Writes the dirty pages of the file mappings in the LENGTH bytes at
+ * ADDR back to their files. */
+int msync(void *addr, size_t length)
+{
+#ifdef VM
+    return do_msync(addr, length);
+#else
+    return -1;
+#endif
+}
+
+/* Limits the user stack of this process to SIZE bytes. */
+int stacklimit(size_t size)
+{
+#ifdef VM
+    return vm_set_stack_limit(size);
+#else
+    return -1;
+#endif
+}
+
+/* Copies page fault latencies to FS. */
+int faultstat(struct faultstat *fs)
+{
+#ifdef VM
+    check_addr((uint64_t *)fs);
+    check_buffer((uint64_t *)fs);
+    check_buffer((uint64_t *)((uint8_t *)fs + sizeof *fs - 1));
+    vm_faultstat(fs);
+    return 0;
+#else
+    return -1;
+#endif
+}
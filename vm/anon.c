@@ -6,6 +6,12 @@
 #include "threads/mmu.h"
 #include "threads/vaddr.h"
 #include "threads/synch.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "vm/zswap.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 extern struct lock frame_lock;
 struct lock swap_lock;
@@ -13,6 +19,65 @@ struct lock swap_lock;
 /* DO NOT MODIFY BELOW LINE */
 static struct disk *swap_disk;
 struct bitmap *sdt;
+/* Number of pages that refer to each swap slot. A frame shared by
+ * several processes is written once and its slot is freed only when the
+ * last of them has swapped it back in or gone away. */
+static uint16_t *slot_refs;
+/* Process that owned the page last written to each slot. Readahead only
+ * pulls in neighbouring slots of the same process. */
+static struct thread **slot_owner;
+
+/* Sectors per swap slot. */
+#define SLOT_SECTORS (PGSIZE / DISK_SECTOR_SIZE)
+
+/* Swap devices, set at boot with "-swap=LIST"; see vm_anon_init(). */
+const char *swap_devices = "hd1:1";
+
+/* A swap device. The slots of all devices are numbered consecutively,
+ * so that one bitmap, sdt, tracks every slot; device I owns slots
+ * [BASE, BASE + SLOT_CNT). The table is fixed once vm_anon_init() is
+ * done, so reading it needs no lock. */
+#define SWAP_AREA_MAX 8
+struct swap_area {
+    char name[16];      /* "hdC:D" or "ram". */
+    struct disk *disk;  /* Disk holding the slots, or NULL. */
+    void **ram;         /* Without a disk, one kernel page per slot. */
+    int prio;           /* Higher priorities are used first. */
+    size_t base;        /* First slot. */
+    size_t slot_cnt;    /* Number of slots. */
+    long long out_cnt;  /* # of pages written. */
+    long long in_cnt;   /* # of pages read. */
+};
+/* Sorted by descending priority; areas of equal priority are used in
+ * turn, so that runs of swap-outs alternate between them. */
+static struct swap_area swap_areas[SWAP_AREA_MAX];
+static size_t swap_area_cnt;
+static size_t swap_rr; /* Round-robin cursor. Protected by swap_lock. */
+
+/* Number of slots read ahead on a swap-in, including the faulting one. */
+#define SWAP_READAHEAD 8
+
+/* Swap cache: slots read ahead of time, kept in kernel pages until they
+ * are faulted in or freed. Protected by swap_lock. */
+#define SWAP_CACHE_SIZE 32
+struct swap_cache_entry {
+    size_t slot_idx; /* Cached slot. */
+    void *kva;       /* Its contents, NULL if the entry is unused. */
+};
+static struct swap_cache_entry swap_cache[SWAP_CACHE_SIZE];
+static size_t swap_cache_hand;
+
+/* Statistics. */
+static long long swap_out_cnt;     /* # of pages written. */
+static long long swap_cluster_cnt; /* # of contiguous runs written. */
+static long long swap_in_cnt;      /* # of pages read on demand. */
+static long long readahead_cnt;    /* # of pages read ahead. */
+static long long readahead_hits;   /* # of swap-ins served by the cache. */
+
+static void swap_disk_write(size_t slot_idx, const void *kva);
+static void swap_write(size_t first, void *const kvas[], size_t cnt);
+static void swap_read(size_t first, void *const kvas[], size_t cnt);
+static void swap_slot_release(size_t slot_idx);
 static bool anon_swap_in(struct page *page, void *kva);
 static bool anon_swap_out(struct page *page);
 static void anon_destroy(struct page *page);
@@ -25,71 +90,445 @@ static const struct page_operations anon_ops = {
     .type = VM_ANON,
 };
 
-/* Initialize the data for anonymous pages */
+/* Sets up swap device NAME, "hd1:D" for an IDE disk or "ram:PAGES" for
+ * PAGES kernel pages, with priority PRIO. Channel 0 holds the kernel
+ * and the file system, so its disks are refused. */
+static bool
+swap_area_add(const char *name, int prio) {
+    struct swap_area *a = &swap_areas[swap_area_cnt];
+
+    if (swap_area_cnt == SWAP_AREA_MAX)
+        return false;
+    memset(a, 0, sizeof *a);
+    a->prio = prio;
+    if (name[0] == 'h' && name[1] == 'd' && name[3] == ':') {
+        int chan = name[2] - '0', dev = name[4] - '0';
+
+        if (chan != 1 || (dev != 0 && dev != 1))
+            return false;
+        a->disk = disk_get(chan, dev);
+        if (a->disk == NULL)
+            return false;
+        a->slot_cnt = disk_size(a->disk) / SLOT_SECTORS;
+        strlcpy(a->name, name, sizeof a->name);
+    } else if (strstr(name, "ram:") == name) {
+        size_t cnt = atoi(name + 4);
+
+        a->ram = calloc(cnt, sizeof *a->ram);
+        if (a->ram == NULL)
+            return false;
+        while (a->slot_cnt < cnt &&
+               (a->ram[a->slot_cnt] = palloc_get_page(0)) != NULL)
+            a->slot_cnt++;
+        strlcpy(a->name, "ram", sizeof a->name);
+    } else
+        return false;
+
+    if (a->slot_cnt == 0)
+        return false;
+    swap_area_cnt++;
+    return true;
+}
+
+/* Initialize the data for anonymous pages.
+ * Swap goes to the devices in swap_devices, a comma-separated list of
+ * "DEVICE[@PRIO]" entries; see swap_area_add() for DEVICE. */
 void vm_anon_init(void) {
-    /* TODO: Set up the swap_disk. */
-    swap_disk = disk_get(1, 1);
-    size_t swap_size = disk_size(swap_disk) / (PGSIZE / DISK_SECTOR_SIZE);
+    char list[128], *dev, *save_ptr;
+    size_t swap_size = 0;
+
+    strlcpy(list, swap_devices, sizeof list);
+    for (dev = strtok_r(list, ",", &save_ptr); dev != NULL;
+         dev = strtok_r(NULL, ",", &save_ptr)) {
+        char *at = strchr(dev, '@');
+        int prio = 0;
+
+        if (at != NULL) {
+            *at = '\0';
+            prio = atoi(at + 1);
+        }
+        if (!swap_area_add(dev, prio))
+            printf("swap: cannot use `%s'\n", dev);
+    }
+
+    /* Stable sort by priority, then number the slots. */
+    for (size_t i = 1; i < swap_area_cnt; i++)
+        for (size_t j = i; j > 0 && swap_areas[j - 1].prio < swap_areas[j].prio; j--) {
+            struct swap_area t = swap_areas[j];
+            swap_areas[j] = swap_areas[j - 1];
+            swap_areas[j - 1] = t;
+        }
+    for (size_t i = 0; i < swap_area_cnt; i++) {
+        swap_areas[i].base = swap_size;
+        swap_size += swap_areas[i].slot_cnt;
+    }
+    swap_disk = swap_area_cnt > 0 ? swap_areas[0].disk : NULL;
+
     sdt = bitmap_create(swap_size); // 전체 slot 수
     bitmap_set_all(sdt, true);
+    slot_refs = calloc(swap_size, sizeof *slot_refs);
+    slot_owner = calloc(swap_size, sizeof *slot_owner);
     lock_init(&swap_lock);
+    zswap_init(swap_size, swap_disk_write);
+}
+
+/* Returns the swap device that holds SLOT_IDX. */
+static struct swap_area *
+swap_area_of(size_t slot_idx) {
+    for (size_t i = 0; i < swap_area_cnt; i++)
+        if (slot_idx < swap_areas[i].base + swap_areas[i].slot_cnt)
+            return &swap_areas[i];
+    NOT_REACHED();
+}
+
+/* Allocates CNT contiguous slots on a single device, taking the devices
+ * of the highest priority with room first and those of equal priority
+ * in turn. Returns the first slot, or BITMAP_ERROR. Must hold
+ * swap_lock. */
+static size_t
+swap_alloc(size_t cnt) {
+    for (size_t g = 0, e; g < swap_area_cnt; g = e) {
+        for (e = g + 1; e < swap_area_cnt && swap_areas[e].prio == swap_areas[g].prio; e++)
+            continue;
+        for (size_t k = 0; k < e - g; k++) {
+            struct swap_area *a = &swap_areas[g + (swap_rr + k) % (e - g)];
+            size_t first = bitmap_scan(sdt, a->base, cnt, true);
+
+            /* The lowest fit is past this device, so there is none on it. */
+            if (first == BITMAP_ERROR || first + cnt > a->base + a->slot_cnt)
+                continue;
+            bitmap_set_multiple(sdt, first, cnt, false);
+            swap_rr++;
+            return first;
+        }
+    }
+    return BITMAP_ERROR;
+}
+
+/* Writes the CNT pages KVAS to the contiguous slots starting at FIRST,
+ * which lie on one device, with one disk request per DISK_MULTIPLE_MAX
+ * sectors. The caller owns the slots, so swap_lock is not needed. */
+static void
+swap_write(size_t first, void *const kvas[], size_t cnt) {
+    struct swap_area *a = swap_area_of(first);
+    const void *sectors[DISK_MULTIPLE_MAX];
+    size_t done = 0;
+
+    a->out_cnt += cnt;
+    if (a->disk == NULL) {
+        for (size_t i = 0; i < cnt; i++)
+            memcpy(a->ram[first - a->base + i], kvas[i], PGSIZE);
+        return;
+    }
+    while (done < cnt) {
+        size_t n = cnt - done;
+
+        if (n > DISK_MULTIPLE_MAX / SLOT_SECTORS)
+            n = DISK_MULTIPLE_MAX / SLOT_SECTORS;
+        for (size_t i = 0; i < n * SLOT_SECTORS; i++)
+            sectors[i] = (uint8_t *) kvas[done + i / SLOT_SECTORS]
+                         + i % SLOT_SECTORS * DISK_SECTOR_SIZE;
+        disk_write_multiple(a->disk, (first - a->base + done) * SLOT_SECTORS,
+                            sectors, n * SLOT_SECTORS);
+        done += n;
+    }
+}
+
+/* Writes KVA to swap slot SLOT_IDX. Called by the compressed pool with
+ * swap_lock held. */
+static void
+swap_disk_write(size_t slot_idx, const void *kva) {
+    void *kvas[1] = { (void *) kva };
+
+    swap_write(slot_idx, kvas, 1);
+}
+
+/* Reads the CNT contiguous slots starting at FIRST, which lie on one
+ * device, into the pages KVAS, with one disk request per
+ * DISK_MULTIPLE_MAX sectors. The caller holds a reference to each slot,
+ * so swap_lock is not needed. */
+static void
+swap_read(size_t first, void *const kvas[], size_t cnt) {
+    struct swap_area *a = swap_area_of(first);
+    void *sectors[DISK_MULTIPLE_MAX];
+    size_t done = 0;
+
+    a->in_cnt += cnt;
+    if (a->disk == NULL) {
+        for (size_t i = 0; i < cnt; i++)
+            memcpy(kvas[i], a->ram[first - a->base + i], PGSIZE);
+        return;
+    }
+    while (done < cnt) {
+        size_t n = cnt - done;
+
+        if (n > DISK_MULTIPLE_MAX / SLOT_SECTORS)
+            n = DISK_MULTIPLE_MAX / SLOT_SECTORS;
+        for (size_t i = 0; i < n * SLOT_SECTORS; i++)
+            sectors[i] = (uint8_t *) kvas[done + i / SLOT_SECTORS]
+                         + i % SLOT_SECTORS * DISK_SECTOR_SIZE;
+        disk_read_multiple(a->disk, (first - a->base + done) * SLOT_SECTORS,
+                           sectors, n * SLOT_SECTORS);
+        done += n;
+    }
+}
+
+/* Returns the swap cache entry for SLOT_IDX, or NULL. Must hold
+ * swap_lock. */
+static struct swap_cache_entry *
+swap_cache_lookup(size_t slot_idx) {
+    for (int i = 0; i < SWAP_CACHE_SIZE; i++)
+        if (swap_cache[i].kva != NULL && swap_cache[i].slot_idx == slot_idx)
+            return &swap_cache[i];
+    return NULL;
+}
+
+/* Releases the swap cache entry E. Must hold swap_lock. */
+static void
+swap_cache_drop(struct swap_cache_entry *e) {
+    palloc_free_page(e->kva);
+    e->kva = NULL;
+}
+
+/* Reads the in-use neighbours of SLOT_IDX on its device that belong to
+ * OWNER into the swap cache, stopping at the first slot that does not.
+ * Slots held by the compressed pool are skipped, and so are slots still
+ * being written, which have no references yet. Must hold swap_lock,
+ * which is dropped during the reads so that other swap-ins and
+ * swap-outs need not wait for them; each slot read is pinned by a
+ * reference meanwhile, so that it cannot be freed and reused. */
+static void
+swap_readahead(size_t slot_idx, struct thread *owner) {
+    struct swap_area *a = swap_area_of(slot_idx);
+    size_t end = slot_idx + SWAP_READAHEAD;
+    size_t slots[SWAP_READAHEAD];
+    void *kvas[SWAP_READAHEAD];
+    size_t cnt = 0, nread = 0;
+
+    if (end > a->base + a->slot_cnt)
+        end = a->base + a->slot_cnt;
+    for (size_t s = slot_idx + 1; s < end; s++) {
+        if (bitmap_test(sdt, s) || slot_refs[s] == 0 || slot_owner[s] != owner)
+            break;
+        if (swap_cache_lookup(s) != NULL || zswap_contains(s))
+            continue;
+        slot_refs[s]++;
+        slots[cnt++] = s;
+    }
+    if (cnt == 0)
+        return;
+
+    lock_release(&swap_lock);
+    while (nread < cnt && (kvas[nread] = palloc_get_page(0)) != NULL)
+        nread++;
+    /* Read each run of adjacent slots with one request. */
+    for (size_t i = 0, j; i < nread; i = j) {
+        for (j = i + 1; j < nread && slots[j] == slots[j - 1] + 1; j++)
+            continue;
+        swap_read(slots[i], &kvas[i], j - i);
+    }
+    lock_acquire(&swap_lock);
+
+    for (size_t i = 0; i < cnt; i++) {
+        struct swap_cache_entry *e;
+
+        /* Drop what the owner freed, or someone else read ahead, while
+         * we were reading. */
+        if (--slot_refs[slots[i]] == 0)
+            swap_slot_release(slots[i]);
+        else if (i < nread && swap_cache_lookup(slots[i]) == NULL) {
+            e = &swap_cache[swap_cache_hand];
+            swap_cache_hand = (swap_cache_hand + 1) % SWAP_CACHE_SIZE;
+            if (e->kva != NULL)
+                palloc_free_page(e->kva);
+            e->kva = kvas[i];
+            e->slot_idx = slots[i];
+            readahead_cnt++;
+            continue;
+        }
+        if (i < nread)
+            palloc_free_page(kvas[i]);
+    }
+}
+
+/* Releases SLOT_IDX, whose last reference is gone. Must hold
+ * swap_lock. */
+static void
+swap_slot_release(size_t slot_idx) {
+    struct swap_cache_entry *e = swap_cache_lookup(slot_idx);
+
+    if (e != NULL)
+        swap_cache_drop(e);
+    zswap_invalidate(slot_idx);
+    slot_owner[slot_idx] = NULL;
+    bitmap_set(sdt, slot_idx, true);
+}
+
+/* Adds a reference to swap slot SLOT_IDX. */
+void swap_slot_dup(size_t slot_idx) {
+    if (slot_idx == BITMAP_ERROR)
+        return;
+    lock_acquire(&swap_lock);
+    slot_refs[slot_idx]++;
+    lock_release(&swap_lock);
+}
+
+/* Drops a reference to swap slot SLOT_IDX, freeing it on the last one. */
+void swap_slot_free(size_t slot_idx) {
+    if (slot_idx == BITMAP_ERROR)
+        return;
+    lock_acquire(&swap_lock);
+    if (--slot_refs[slot_idx] == 0)
+        swap_slot_release(slot_idx);
+    lock_release(&swap_lock);
 }
 
 /* Initialize the file mapping */
 bool anon_initializer(struct page *page, enum vm_type type, void *kva) {
     /* Set up the handler */
     page->operations = &anon_ops;
+    page->slot_idx = BITMAP_ERROR;
 
     struct anon_page *anon_page = &page->anon;
+    return true;
 }
 
-/* Swap in the page by read contents from the swap disk. */
+/* Swap in the page by read contents from the swap disk.
+ * A slot held by the compressed pool is decompressed from it, and one
+ * that was read ahead is copied out of the swap cache; otherwise it is
+ * read along with the neighbouring slots of the same process. */
 static bool
 anon_swap_in(struct page *page, void *kva) {
     struct anon_page *anon_page = &page->anon;
+    size_t slot_idx = page->slot_idx;
+    struct swap_cache_entry *e;
+
+    if (slot_idx == BITMAP_ERROR)
+        return true;
     lock_acquire(&swap_lock);
-    for (int i = 0; i < 8; i++) {
-        disk_read(swap_disk, (page->slot_idx) * 8 + i, kva + (i * DISK_SECTOR_SIZE));
+    e = swap_cache_lookup(slot_idx);
+    if (zswap_load(slot_idx, kva))
+        ;
+    else if (e != NULL) {
+        memcpy(kva, e->kva, PGSIZE);
+        readahead_hits++;
+    } else {
+        /* Our reference keeps the slot ours, so other devices' I/O
+         * need not wait for this read. */
+        lock_release(&swap_lock);
+        swap_read(slot_idx, &kva, 1);
+        lock_acquire(&swap_lock);
+        swap_in_cnt++;
+        swap_readahead(slot_idx, slot_owner[slot_idx]);
     }
-    bitmap_flip(sdt, page->slot_idx);
     lock_release(&swap_lock);
+    page->slot_idx = BITMAP_ERROR;
+    swap_slot_free(slot_idx);
     return true;
 }
 
 /* Swap out the page by writing contents to the swap disk. */
 static bool
 anon_swap_out(struct page *page) {
-    struct anon_page *anon_page = &page->anon;
+    struct frame *frame = page->frame;
+
+    return anon_swap_out_cluster(&frame, 1) == 1;
+}
+
+/* Swaps out the CNT anonymous FRAMES, all owned by the caller as
+ * victims, to one run of contiguous slots on one swap device. Frames
+ * that the compressed pool takes are not written; the rest go out in as
+ * few disk requests as their runs allow, without holding swap_lock, so
+ * that devices on other channels stay busy meanwhile. Each frame is
+ * unmapped from every process that shares it through the reverse map,
+ * written once, and all of its mappers then point at the same slot.
+ * Returns the number of leading FRAMES written, which is less than CNT
+ * if no run that long is free. */
+size_t
+anon_swap_out_cluster(struct frame *frames[], size_t cnt) {
+    void *kvas[cnt];
+    size_t first, run = 0;
+
     lock_acquire(&swap_lock);
-    size_t slot_idx = bitmap_scan_and_flip(sdt, 0, 1, true);
-    if (slot_idx == BITMAP_ERROR) {
+    while ((first = swap_alloc(cnt)) == BITMAP_ERROR && cnt > 1)
+        cnt /= 2;
+    lock_release(&swap_lock);
+    if (first == BITMAP_ERROR)
+        return 0;
+
+    for (size_t i = 0; i < cnt; i++)
+        frame_unmap_all(frames[i]);
+    for (size_t i = 0; i < cnt; i++) {
+        bool stored;
+
+        lock_acquire(&swap_lock);
+        stored = zswap_store(first + i, frames[i]->kva);
         lock_release(&swap_lock);
-        return false;
+        if (!stored)
+            kvas[run++] = frames[i]->kva;
+        /* Write the run of frames the pool did not take that ends here. */
+        if (run > 0 && (stored || i == cnt - 1)) {
+            size_t end = stored ? i : i + 1;
+
+            swap_write(first + end - run, kvas, run);
+            run = 0;
+        }
     }
+    lock_acquire(&swap_lock);
+    swap_out_cnt += cnt;
+    swap_cluster_cnt++;
     lock_release(&swap_lock);
 
-    page->slot_idx = slot_idx;
+    /* Lock order is frame_lock, then swap_lock. */
+    lock_acquire(&frame_lock);
     lock_acquire(&swap_lock);
+    for (size_t i = 0; i < cnt; i++) {
+        struct frame *frame = frames[i];
+        size_t slot_idx = first + i;
 
-    for (int i = 0; i < 8; i++) {
-        disk_write(swap_disk, slot_idx * 8 + i, (page->frame->kva) + (i * DISK_SECTOR_SIZE));
+        slot_owner[slot_idx] = frame->page != NULL ? frame->page->owner : NULL;
+        while (!list_empty(&frame->rmap)) {
+            struct page *p = list_entry(list_pop_front(&frame->rmap), struct page, rmap_elem);
+            p->slot_idx = slot_idx;
+            p->frame = NULL;
+            slot_refs[slot_idx]++;
+        }
+        frame->ref_count = 0;
+        frame->page = NULL;
+        /* Everyone went away during the write. */
+        if (slot_refs[slot_idx] == 0)
+            swap_slot_release(slot_idx);
     }
-
     lock_release(&swap_lock);
-    pml4_clear_page(thread_current()->pml4, page->va);
+    lock_release(&frame_lock);
 
-    return true;
+    return cnt;
+}
+
+/* Prints swap statistics. */
+void
+anon_print_stats(void) {
+    printf("Swap: %lld pages out in %lld runs, %lld pages in, "
+           "%lld read ahead, %lld readahead hits\n",
+           swap_out_cnt, swap_cluster_cnt, swap_in_cnt, readahead_cnt,
+           readahead_hits);
+    for (size_t i = 0; i < swap_area_cnt; i++) {
+        struct swap_area *a = &swap_areas[i];
+
+        printf("Swap device %s (priority %d): %zu slots, "
+               "%lld pages out, %lld pages in\n",
+               a->name, a->prio, a->slot_cnt, a->out_cnt, a->in_cnt);
+    }
 }
 
 /* Destroy the anonymous page. PAGE will be freed by the caller. */
 static void
 anon_destroy(struct page *page) {
     struct anon_page *anon_page = &page->anon;
-    lock_acquire(&swap_lock);
-    bitmap_set(sdt, page->slot_idx, true);
-    lock_release(&swap_lock);
-    if (page->frame && page->frame->page == page) {
-        free_frame(page->frame);
+    if (page->frame) {
+        free_frame(page);
+    } else {
+        swap_slot_free(page->slot_idx);
     }
     pml4_clear_page(thread_current()->pml4, page->va);
 }
@@ -0,0 +1,535 @@
+/* evict.c: Page replacement policies behind the frame table.
+ *
+ * vm.c hands every resident, evictable frame to the active policy with
+ * evict_admit() and asks it for a victim with evict_pick(). The policy is
+ * chosen at boot with "-evict=POLICY"; the default is the clock. */
+
+#include "vm/evict.h"
+#include "threads/synch.h"
+#include "vm/vm.h"
+#include <stdio.h>
+#include <string.h>
+
+extern struct lock frame_lock;
+
+static void clock_init(void);
+static void clock_admit(struct frame *frame);
+static void clock_remove(struct frame *frame);
+static struct frame *clock_victim(void);
+
+static void twoq_init(void);
+static void twoq_admit(struct frame *frame);
+static void twoq_remove(struct frame *frame);
+static struct frame *twoq_victim(void);
+
+static void clockpro_init(void);
+static void clockpro_admit(struct frame *frame);
+static void clockpro_remove(struct frame *frame);
+static struct frame *clockpro_victim(void);
+
+static struct evict_policy policies[] = {
+    {.name = "clock",
+     .init = clock_init,
+     .admit = clock_admit,
+     .remove = clock_remove,
+     .victim = clock_victim},
+    {.name = "2q",
+     .init = twoq_init,
+     .admit = twoq_admit,
+     .remove = twoq_remove,
+     .victim = twoq_victim},
+    {.name = "clockpro",
+     .init = clockpro_init,
+     .admit = clockpro_admit,
+     .remove = clockpro_remove,
+     .victim = clockpro_victim},
+};
+
+static struct evict_policy *policy = &policies[0];
+
+static void ghost_drop(struct page *page);
+
+/* Number of frames currently held by the policy. */
+static size_t resident_cnt;
+
+/* Recently evicted pages, remembered to detect re-faults.
+ * Used by 2Q (its A1out queue) and CLOCK-Pro (non-resident cold pages
+ * in their test period). */
+static struct list ghost_list;
+static size_t ghost_cnt;
+
+/* Frames deactivated by MADV_SEQUENTIAL, taken away from the policy and
+ * handed out as victims before anything it holds. */
+static struct list inactive_list;
+static size_t inactive_cnt;
+static uint64_t inactive_victims; /* # of victims taken from the list. */
+
+/* Selects the policy called NAME. Returns false if there is none. */
+bool evict_set_policy(const char *name)
+{
+    for (size_t i = 0; i < sizeof policies / sizeof *policies; i++)
+        if (!strcmp(policies[i].name, name))
+        {
+            policy = &policies[i];
+            return true;
+        }
+    return false;
+}
+
+void evict_init(void)
+{
+    list_init(&ghost_list);
+    list_init(&inactive_list);
+    policy->init();
+}
+
+/* Makes FRAME, which has just been faulted in, a replacement candidate. */
+void evict_admit(struct frame *frame)
+{
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+    policy->stats.faults++;
+    resident_cnt++;
+    policy->admit(frame);
+}
+
+/* Returns FRAME, which could not be evicted after all, to the policy. */
+void evict_putback(struct frame *frame)
+{
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+    if (frame->page != NULL)
+        ghost_drop(frame->page);
+    resident_cnt++;
+    policy->admit(frame);
+}
+
+/* Forgets FRAME, which is being freed. */
+void evict_remove(struct frame *frame)
+{
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+    if (frame->inactive)
+    {
+        list_remove(&frame->elem);
+        frame->inactive = false;
+        inactive_cnt--;
+        return;
+    }
+    resident_cnt--;
+    policy->remove(frame);
+}
+
+/* Moves FRAME, which the policy holds, to the front of the line for
+ * eviction. Its accessed bits are cleared, so that a frame used again
+ * before it is picked goes back to the policy instead. */
+void evict_deactivate(struct frame *frame)
+{
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+    if (frame->inactive || frame->evicting)
+        return;
+    resident_cnt--;
+    policy->remove(frame);
+    frame_test_and_clear_accessed(frame);
+    frame->inactive = true;
+    list_push_back(&inactive_list, &frame->elem);
+    inactive_cnt++;
+}
+
+/* Chooses a victim and takes it away from the policy.
+ * Returns NULL if there is no resident frame at all. */
+struct frame *evict_pick(void)
+{
+    struct frame *victim;
+
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+    while (!list_empty(&inactive_list))
+    {
+        victim = list_entry(list_pop_front(&inactive_list), struct frame,
+                            elem);
+        victim->inactive = false;
+        inactive_cnt--;
+        if (frame_test_and_clear_accessed(victim))
+        {
+            resident_cnt++;
+            policy->admit(victim);
+            continue;
+        }
+        policy->stats.evictions++;
+        inactive_victims++;
+        return victim;
+    }
+    if (resident_cnt == 0)
+        return NULL;
+    victim = policy->victim();
+    if (victim)
+    {
+        resident_cnt--;
+        policy->stats.evictions++;
+    }
+    return victim;
+}
+
+/* Drops PAGE, which is being destroyed, from the ghost list. */
+void evict_forget(struct page *page)
+{
+    lock_acquire(&frame_lock);
+    ghost_drop(page);
+    lock_release(&frame_lock);
+}
+
+void evict_print_stats(void)
+{
+    printf("Evict: %s policy, %llu hits, %llu faults, %llu evictions, "
+           "%llu ghost hits\n",
+           policy->name, policy->stats.hits, policy->stats.faults,
+           policy->stats.evictions, policy->stats.ghost_hits);
+    printf("Evict: %llu sequential victims, %zu frames inactive\n",
+           inactive_victims, inactive_cnt);
+}
+
+/* Returns the element after E in the circular list L. */
+static struct list_elem *ring_next(struct list *l, struct list_elem *e)
+{
+    e = list_next(e);
+    return e == list_end(l) ? list_begin(l) : e;
+}
+
+/* Removes PAGE from the ghost list, if it is there. */
+static void ghost_drop(struct page *page)
+{
+    if (page->ghost)
+    {
+        list_remove(&page->ghost_elem);
+        page->ghost = false;
+        ghost_cnt--;
+    }
+}
+
+/* Remembers FRAME's page as recently evicted, keeping at most CAP ghosts.
+ * Returns the number of old ghosts that had to be dropped. */
+static size_t ghost_add(struct frame *frame, size_t cap)
+{
+    struct page *page = frame->page;
+    size_t expired = 0;
+
+    if (page != NULL && !page->ghost)
+    {
+        page->ghost = true;
+        list_push_back(&ghost_list, &page->ghost_elem);
+        ghost_cnt++;
+    }
+    while (ghost_cnt > cap)
+    {
+        struct page *old = list_entry(list_pop_front(&ghost_list),
+                                      struct page, ghost_elem);
+        old->ghost = false;
+        ghost_cnt--;
+        expired++;
+    }
+    return expired;
+}
+
+/* Returns true if FRAME's page was a ghost, and forgets it. */
+static bool ghost_take(struct frame *frame)
+{
+    struct page *page = frame->page;
+
+    if (page == NULL || !page->ghost)
+        return false;
+    ghost_drop(page);
+    policy->stats.ghost_hits++;
+    return true;
+}
+
+/* Clock with a persistent hand.
+ * New frames go just behind the hand, so they get a full revolution
+ * before they are looked at. */
+static struct list clock_ring;
+static struct list_elem *clock_hand;
+
+static void clock_init(void)
+{
+    list_init(&clock_ring);
+    clock_hand = NULL;
+}
+
+static void clock_admit(struct frame *frame)
+{
+    if (clock_hand == NULL)
+        list_push_back(&clock_ring, &frame->elem);
+    else
+        list_insert(clock_hand, &frame->elem);
+}
+
+static void clock_remove(struct frame *frame)
+{
+    if (clock_hand == &frame->elem)
+        clock_hand = ring_next(&clock_ring, clock_hand);
+    list_remove(&frame->elem);
+    if (list_empty(&clock_ring))
+        clock_hand = NULL;
+}
+
+static struct frame *clock_victim(void)
+{
+    if (list_empty(&clock_ring))
+        return NULL;
+    if (clock_hand == NULL)
+        clock_hand = list_begin(&clock_ring);
+
+    for (;;)
+    {
+        struct frame *frame = list_entry(clock_hand, struct frame, elem);
+
+        if (!frame_test_and_clear_accessed(frame))
+        {
+            clock_remove(frame);
+            return frame;
+        }
+        policy->stats.hits++;
+        clock_hand = ring_next(&clock_ring, clock_hand);
+    }
+}
+
+/* 2Q.
+ * First-time pages enter the A1in FIFO. Pages that come back while
+ * remembered in A1out (the ghost list) are hot and go to Am, which is
+ * managed by a clock. A1in holds a quarter of the frames, A1out
+ * remembers half as many pages as there are frames. */
+enum twoq_queue
+{
+    TWOQ_A1IN = 1,
+    TWOQ_AM,
+};
+
+static struct list twoq_a1in, twoq_am;
+static size_t twoq_a1in_cnt, twoq_am_cnt;
+static struct list_elem *twoq_hand;
+
+static void twoq_init(void)
+{
+    list_init(&twoq_a1in);
+    list_init(&twoq_am);
+    twoq_hand = NULL;
+}
+
+static void twoq_admit(struct frame *frame)
+{
+    if (ghost_take(frame))
+    {
+        frame->evict_state = TWOQ_AM;
+        if (twoq_hand == NULL)
+            list_push_back(&twoq_am, &frame->elem);
+        else
+            list_insert(twoq_hand, &frame->elem);
+        twoq_am_cnt++;
+    }
+    else
+    {
+        frame->evict_state = TWOQ_A1IN;
+        list_push_back(&twoq_a1in, &frame->elem);
+        twoq_a1in_cnt++;
+    }
+}
+
+static void twoq_remove(struct frame *frame)
+{
+    if (frame->evict_state == TWOQ_AM)
+    {
+        if (twoq_hand == &frame->elem)
+            twoq_hand = ring_next(&twoq_am, twoq_hand);
+        list_remove(&frame->elem);
+        if (list_empty(&twoq_am))
+            twoq_hand = NULL;
+        twoq_am_cnt--;
+    }
+    else
+    {
+        list_remove(&frame->elem);
+        twoq_a1in_cnt--;
+    }
+}
+
+static struct frame *twoq_victim(void)
+{
+    size_t total = twoq_a1in_cnt + twoq_am_cnt;
+    size_t kin = total / 4 > 0 ? total / 4 : 1;
+    struct frame *frame;
+
+    if (twoq_a1in_cnt > kin || twoq_am_cnt == 0)
+    {
+        frame = list_entry(list_front(&twoq_a1in), struct frame, elem);
+        twoq_remove(frame);
+        ghost_add(frame, total / 2 > 0 ? total / 2 : 1);
+        return frame;
+    }
+
+    if (twoq_hand == NULL)
+        twoq_hand = list_begin(&twoq_am);
+    for (;;)
+    {
+        frame = list_entry(twoq_hand, struct frame, elem);
+        if (!frame_test_and_clear_accessed(frame))
+        {
+            twoq_remove(frame);
+            return frame;
+        }
+        policy->stats.hits++;
+        twoq_hand = ring_next(&twoq_am, twoq_hand);
+    }
+}
+
+/* CLOCK-Pro.
+ * Resident frames are hot or cold, each kind on its own clock. A cold
+ * frame starts a test period when it is faulted in or referenced; if it
+ * is referenced again during the test, it becomes hot. A cold frame
+ * evicted during its test period is remembered as a non-resident ghost,
+ * and a fault on it is admitted hot. The number of cold frames adapts:
+ * ghost hits grow it, ghosts expiring unused shrink it. */
+enum clockpro_state
+{
+    CP_COLD = 1,
+    CP_COLD_TEST,
+    CP_HOT,
+};
+
+static struct list cp_cold, cp_hot;
+static size_t cp_cold_cnt, cp_hot_cnt;
+static struct list_elem *cp_cold_hand, *cp_hot_hand;
+static size_t cp_cold_target;
+
+static void clockpro_init(void)
+{
+    list_init(&cp_cold);
+    list_init(&cp_hot);
+    cp_cold_hand = cp_hot_hand = NULL;
+    cp_cold_target = 1;
+}
+
+/* Inserts FRAME behind HAND in ring L. */
+static void ring_insert(struct list *l, struct list_elem *hand,
+                        struct frame *frame)
+{
+    if (hand == NULL)
+        list_push_back(l, &frame->elem);
+    else
+        list_insert(hand, &frame->elem);
+}
+
+/* Removes FRAME from ring L, moving *HAND off it first. */
+static void ring_remove(struct list *l, struct list_elem **hand,
+                        struct frame *frame)
+{
+    if (*hand == &frame->elem)
+        *hand = ring_next(l, *hand);
+    list_remove(&frame->elem);
+    if (list_empty(l))
+        *hand = NULL;
+}
+
+/* Runs the hot hand until one hot frame has been demoted to cold. */
+static void clockpro_demote_one(void)
+{
+    if (cp_hot_cnt == 0)
+        return;
+    if (cp_hot_hand == NULL)
+        cp_hot_hand = list_begin(&cp_hot);
+
+    for (;;)
+    {
+        struct frame *frame = list_entry(cp_hot_hand, struct frame, elem);
+
+        if (!frame_test_and_clear_accessed(frame))
+        {
+            ring_remove(&cp_hot, &cp_hot_hand, frame);
+            cp_hot_cnt--;
+            frame->evict_state = CP_COLD;
+            ring_insert(&cp_cold, cp_cold_hand, frame);
+            cp_cold_cnt++;
+            return;
+        }
+        policy->stats.hits++;
+        cp_hot_hand = ring_next(&cp_hot, cp_hot_hand);
+    }
+}
+
+/* Keeps the hot set within its share of the resident frames. */
+static void clockpro_balance(void)
+{
+    while (cp_hot_cnt > 0 && cp_hot_cnt + cp_cold_target > resident_cnt)
+        clockpro_demote_one();
+}
+
+static void clockpro_admit(struct frame *frame)
+{
+    if (ghost_take(frame))
+    {
+        if (cp_cold_target < resident_cnt)
+            cp_cold_target++;
+        frame->evict_state = CP_HOT;
+        ring_insert(&cp_hot, cp_hot_hand, frame);
+        cp_hot_cnt++;
+        clockpro_balance();
+    }
+    else
+    {
+        frame->evict_state = CP_COLD_TEST;
+        ring_insert(&cp_cold, cp_cold_hand, frame);
+        cp_cold_cnt++;
+    }
+}
+
+static void clockpro_remove(struct frame *frame)
+{
+    if (frame->evict_state == CP_HOT)
+    {
+        ring_remove(&cp_hot, &cp_hot_hand, frame);
+        cp_hot_cnt--;
+    }
+    else
+    {
+        ring_remove(&cp_cold, &cp_cold_hand, frame);
+        cp_cold_cnt--;
+    }
+}
+
+static struct frame *clockpro_victim(void)
+{
+    for (;;)
+    {
+        struct frame *frame;
+
+        if (cp_cold_cnt == 0)
+            clockpro_demote_one();
+        if (cp_cold_hand == NULL)
+            cp_cold_hand = list_begin(&cp_cold);
+
+        frame = list_entry(cp_cold_hand, struct frame, elem);
+        if (!frame_test_and_clear_accessed(frame))
+        {
+            bool testing = frame->evict_state == CP_COLD_TEST;
+
+            ring_remove(&cp_cold, &cp_cold_hand, frame);
+            cp_cold_cnt--;
+            if (testing && ghost_add(frame, resident_cnt + 1) > 0 &&
+                cp_cold_target > 1)
+                cp_cold_target--;
+            return frame;
+        }
+
+        policy->stats.hits++;
+        if (frame->evict_state == CP_COLD_TEST)
+        {
+            /* Re-referenced within its test period: promote. */
+            ring_remove(&cp_cold, &cp_cold_hand, frame);
+            cp_cold_cnt--;
+            frame->evict_state = CP_HOT;
+            ring_insert(&cp_hot, cp_hot_hand, frame);
+            cp_hot_cnt++;
+            clockpro_balance();
+        }
+        else
+        {
+            frame->evict_state = CP_COLD_TEST;
+            cp_cold_hand = ring_next(&cp_cold, cp_cold_hand);
+        }
+    }
+}
@@ -1,16 +1,50 @@
 /* file.c: Implementation of memory backed file object (mmaped object). */
 
 #include "vm/vm.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
 #include "threads/mmu.h"
 #include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "vm/evict.h"
+#include "vm/vma.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 static bool file_backed_swap_in(struct page *page, void *kva);
 static bool file_backed_swap_out(struct page *page);
 static void file_backed_destroy(struct page *page);
 static bool lazy_load_file(struct page *page, void *aux);
+static void file_page_writeback(struct page *page, uint64_t *pml4);
+static uint64_t index_hash(const struct hash_elem *e, void *aux);
+static bool index_less(const struct hash_elem *a, const struct hash_elem *b,
+                       void *aux);
 
 struct lock file_swap_lock;
 extern struct lock frame_lock;
+
+/* Frames of file-backed pages, by inode and page offset, so that every
+ * mapping of a page of a file, in any process, maps the same frame, and
+ * read() and write() see the data mapped processes have written.
+ * Protected by frame_lock. A frame leaves the index when it is freed or
+ * evicted. */
+static struct hash file_index;
+static size_t index_cnt;           /* # of frames in the index. */
+static long long share_cnt;        /* # of pages mapped to a frame there. */
+static long long index_read_cnt;   /* # of read() chunks served from it. */
+static long long index_write_cnt;  /* # of write() chunks copied to it. */
+static long long msync_cnt;        /* # of pages written by msync(). */
+static long long text_share_cnt;   /* # of executable pages shared. */
+static long long text_drop_cnt;    /* # of executable frames dropped. */
+
+/* Coalesced writeback of mappings on munmap(), msync() and exit. */
+static long long wb_mapping_cnt;   /* # of mappings written back. */
+static long long wb_page_cnt;      /* # of dirty pages written. */
+static long long wb_run_cnt;       /* # of disk requests they took. */
+static long long wb_coalesced;     /* # of bytes written in multi-page runs. */
+static long long wb_clean_cnt;     /* # of resident clean pages skipped. */
+static size_t wb_max_pages;        /* Most pages written for one mapping. */
 /* DO NOT MODIFY this struct */
 static const struct page_operations file_ops = {
     .swap_in = file_backed_swap_in,
@@ -22,6 +56,278 @@ static const struct page_operations file_ops = {
 /* The initializer of file vm */
 void vm_file_init(void) {
     lock_init(&file_swap_lock);
+    hash_init(&file_index, index_hash, index_less, NULL);
+}
+
+static uint64_t
+index_hash(const struct hash_elem *e, void *aux UNUSED) {
+    const struct frame *f = hash_entry(e, struct frame, index_elem);
+    return hash_bytes(&f->inode, sizeof f->inode) ^ hash_int(f->file_ofs);
+}
+
+static bool
+index_less(const struct hash_elem *a_, const struct hash_elem *b_,
+           void *aux UNUSED) {
+    const struct frame *a = hash_entry(a_, struct frame, index_elem);
+    const struct frame *b = hash_entry(b_, struct frame, index_elem);
+
+    if (a->inode != b->inode)
+        return a->inode < b->inode;
+    return a->file_ofs < b->file_ofs;
+}
+
+/* Returns true if the page at VA of file-backed region VMA holds
+ * exactly what its part of the file holds, up to the end of the file,
+ * so that it can share a frame with every other mapping of it. */
+bool
+file_page_shareable(struct vma *vma, void *va) {
+    off_t ofs = vma_page_offset(vma, va);
+    off_t left = file_length(vma->file) - ofs;
+
+    if (VM_TYPE(vma->type) != VM_FILE || left <= 0)
+        return false;
+    /* A writable mapping of a running executable would write into the
+     * text frames of every process running it. */
+    if (vma->writable && inode_write_denied(file_get_inode(vma->file)))
+        return false;
+    return (off_t)vma_page_read_bytes(vma, va) >= (left < PGSIZE ? left : PGSIZE);
+}
+
+/* Returns the frame that holds the page at OFS of INODE, or NULL. Must
+ * hold frame_lock. */
+struct frame *
+file_index_lookup(struct inode *inode, off_t ofs) {
+    struct frame key;
+    struct hash_elem *e;
+
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+    if (index_cnt == 0)
+        return NULL;
+    key.inode = inode;
+    key.file_ofs = ofs & ~PGMASK;
+    e = hash_find(&file_index, &key.index_elem);
+    return e != NULL ? hash_entry(e, struct frame, index_elem) : NULL;
+}
+
+/* Publishes FRAME as the frame of the page at OFS of INODE. Must hold
+ * frame_lock. */
+void
+file_index_insert(struct frame *frame, struct inode *inode, off_t ofs) {
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+    frame->inode = inode;
+    frame->file_ofs = ofs;
+    hash_insert(&file_index, &frame->index_elem);
+    index_cnt++;
+}
+
+/* Takes FRAME out of the index, if it is there. Must hold frame_lock. */
+void
+file_index_remove(struct frame *frame) {
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+    if (frame->inode == NULL)
+        return;
+    hash_delete(&file_index, &frame->index_elem);
+    frame->inode = NULL;
+    index_cnt--;
+}
+
+/* Counts a page of VMA mapped to a frame found in the index. */
+void
+file_index_note_share(struct vma *vma) {
+    share_cnt++;
+    if (vma->type & VM_TEXT)
+        text_share_cnt++;
+}
+
+/* Copies SIZE bytes at OFS of INODE, which lie in one page, into BUF if
+ * that page is mapped into memory, where it may be newer than on disk.
+ * Returns false if it is not. BUF may be user memory, so it is only
+ * touched without frame_lock held. */
+bool
+file_index_read(struct inode *inode, void *buf, off_t size, off_t ofs) {
+    struct frame *frame;
+    uint8_t *bounce = NULL;
+
+    if (index_cnt == 0)
+        return false;
+    lock_acquire(&frame_lock);
+    frame = file_index_lookup(inode, ofs);
+    if (frame != NULL && !frame->loading && (bounce = malloc(size)) != NULL)
+        memcpy(bounce, frame->kva + (ofs & PGMASK), size);
+    lock_release(&frame_lock);
+
+    if (bounce == NULL)
+        return false;
+    memcpy(buf, bounce, size);
+    free(bounce);
+    index_read_cnt++;
+    return true;
+}
+
+/* Copies SIZE bytes from BUF to OFS of INODE, which lie in one page, into
+ * the frame of that page if it is mapped into memory. inode_write_at()
+ * calls this before writing the disk with LOADED_ONLY, so that an
+ * eviction that writes the frame back meanwhile does not undo the write,
+ * and after it without, so that a frame being read in from the disk
+ * meanwhile does not miss it. */
+void
+file_index_write(struct inode *inode, const void *buf, off_t size, off_t ofs,
+                 bool loaded_only) {
+    struct frame *frame;
+    uint8_t *bounce;
+
+    if (index_cnt == 0)
+        return;
+    lock_acquire(&frame_lock);
+    frame = file_index_lookup(inode, ofs);
+    lock_release(&frame_lock);
+    if (frame == NULL || (bounce = malloc(size)) == NULL)
+        return;
+
+    memcpy(bounce, buf, size);
+    lock_acquire(&frame_lock);
+    frame = file_index_lookup(inode, ofs);
+    /* Writing a frame back to its own file. */
+    if (frame != NULL && frame->kva + (ofs & PGMASK) == buf)
+        frame = NULL;
+    if (frame != NULL && !(loaded_only && frame->loading)) {
+        memcpy(frame->kva + (ofs & PGMASK), bounce, size);
+        if (!loaded_only)
+            index_write_cnt++;
+    }
+    lock_release(&frame_lock);
+    free(bounce);
+}
+
+/* Prints statistics about file-backed pages. */
+void
+file_print_stats(void) {
+    printf("File pages: %zu indexed, %lld mappings shared, "
+           "%lld reads and %lld writes through mapped pages, "
+           "%lld pages synced\n",
+           index_cnt, share_cnt, index_read_cnt, index_write_cnt, msync_cnt);
+    printf("Text pages: %lld shared, %lld frames dropped on eviction\n",
+           text_share_cnt, text_drop_cnt);
+    printf("Writeback: %lld mappings, %lld pages in %lld runs, "
+           "%lld bytes coalesced, %lld clean pages skipped, "
+           "%zu pages most per mapping\n",
+           wb_mapping_cnt, wb_page_cnt, wb_run_cnt, wb_coalesced,
+           wb_clean_cnt, wb_max_pages);
+}
+
+/* Orders pages by address. */
+static int
+page_va_cmp(const void *a_, const void *b_) {
+    const struct page *a = *(struct page *const *) a_;
+    const struct page *b = *(struct page *const *) b_;
+
+    return a->va < b->va ? -1 : a->va > b->va;
+}
+
+/* Writes the dirty resident pages of file mapping VMA in [START, END)
+ * back to its file. Pages that are adjacent in the mapping, and hence
+ * in the file, go out together as one run with a single disk request
+ * per contiguous extent; clean pages are not written at all. Returns
+ * the number of pages written. */
+size_t
+file_writeback_range(struct vma *vma, void *start, void *end) {
+    uint64_t *pml4 = thread_current()->pml4;
+    struct page **dirty;
+    struct frame **frames;
+    void **kvas;
+    struct list_elem *e;
+    size_t cnt = 0, i, j;
+
+    if (VM_TYPE(vma->type) != VM_FILE || !vma->writable
+        || list_empty(&vma->pages))
+        return 0;
+    dirty = malloc(list_size(&vma->pages) * sizeof *dirty);
+    frames = malloc(list_size(&vma->pages) * sizeof *frames);
+    kvas = malloc(list_size(&vma->pages) * sizeof *kvas);
+    if (dirty == NULL || frames == NULL || kvas == NULL) {
+        free(dirty);
+        free(frames);
+        free(kvas);
+        return 0;
+    }
+
+    lock_acquire(&frame_lock);
+    for (e = list_begin(&vma->pages); e != list_end(&vma->pages);
+         e = list_next(e)) {
+        struct page *page = list_entry(e, struct page, vma_elem);
+
+        if (page->va < start || page->va >= end
+            || page->frame == NULL || page->frame->evicting)
+            continue;
+        if (pml4_is_dirty(pml4, page->va)) {
+            /* Take the frame from the replacement policy for the
+             * write, as a victim would be, so that it is neither
+             * evicted nor freed under the I/O. */
+            evict_remove(page->frame);
+            page->frame->evicting = true;
+            dirty[cnt++] = page;
+        } else
+            wb_clean_cnt++;
+    }
+    qsort(dirty, cnt, sizeof *dirty, page_va_cmp);
+    for (i = 0; i < cnt; i++)
+        frames[i] = dirty[i]->frame;
+    lock_release(&frame_lock);
+
+    lock_acquire(&file_swap_lock);
+    for (i = 0; i < cnt; i = j) {
+        off_t size = 0;
+
+        for (j = i; j < cnt; j++) {
+            if (j > i && dirty[j]->va != dirty[j - 1]->va + PGSIZE)
+                break;
+            kvas[j - i] = frames[j]->kva;
+            size += vma_page_read_bytes(vma, dirty[j]->va);
+        }
+        file_write_pages(vma->file, kvas, size,
+                         vma_page_offset(vma, dirty[i]->va));
+        for (; i < j; i++)
+            pml4_set_dirty(pml4, dirty[i]->va, false);
+        wb_run_cnt++;
+        if (size > PGSIZE)
+            wb_coalesced += size;
+    }
+    lock_release(&file_swap_lock);
+
+    /* Hand the frames back, freeing any whose last mapper went away
+     * during the write. */
+    lock_acquire(&frame_lock);
+    for (i = 0; i < cnt; i++) {
+        struct frame *frame = frames[i];
+
+        frame->evicting = false;
+        frame_wake_waiters();
+        if (frame->ref_count > 0) {
+            evict_putback(frame);
+            continue;
+        }
+        file_index_remove(frame);
+        palloc_free_page(frame->kva);
+        free(frame);
+    }
+    lock_release(&frame_lock);
+
+    if (cnt > 0) {
+        wb_mapping_cnt++;
+        wb_page_cnt += cnt;
+        if (cnt > wb_max_pages)
+            wb_max_pages = cnt;
+    }
+    free(dirty);
+    free(frames);
+    free(kvas);
+    return cnt;
+}
+
+/* Writes back every dirty page of file mapping VMA. */
+void
+file_vma_writeback(struct vma *vma) {
+    file_writeback_range(vma, vma->start, vma->end);
 }
 
 /* Initialize the file backed page */
@@ -30,6 +336,7 @@ bool file_backed_initializer(struct page *page, enum vm_type type, void *kva) {
     page->operations = &file_ops;
 
     struct file_page *file_page = &page->file;
+    return true;
 }
 
 /* Swap in the page by read contents from the file. */
@@ -37,150 +344,161 @@ static bool
 file_backed_swap_in(struct page *page, void *kva) {
     struct file_page *file_page UNUSED = &page->file;
 
-    struct load_info *info = (struct load_info *)page->uninit.aux;
-    uint8_t *kpage = page->frame->kva;
-    if (kpage == NULL)
-        return false;
-    file_seek(info->file, info->offset);
-
-    /* Load this page. */
-    lock_acquire(&file_swap_lock);
-    file_seek(info->file, info->offset);
-    file_read(info->file, kpage, info->page_read_bytes);
-    lock_release(&file_swap_lock);
-    return true;
+    return lazy_load_file(page, page->vma);
 }
 
-/* Swap out the page by writeback contents to the file. */
+/* Swap out the page by writeback contents to the file.
+ * The frame is unmapped from every process sharing it, and written back
+ * once if any of them dirtied it. */
 static bool file_backed_swap_out(struct page *page) {
     struct file_page *file_page UNUSED = &page->file;
     if (!page)
         return false;
 
-    struct load_info *info = page->uninit.aux;
+    struct vma *vma = page->vma;
+    struct frame *frame = page->frame;
+    size_t read_bytes = vma_page_read_bytes(vma, page->va);
 
-    lock_acquire(&file_swap_lock);
-
-    if (pml4_is_dirty(thread_current()->pml4, page->va)) {
-        if (file_write_at(info->file, page->frame->kva, info->page_read_bytes,
-                          info->offset) != (int)info->page_read_bytes) {
+    if (frame_unmap_all(frame)) {
+        lock_acquire(&file_swap_lock);
+        if (file_write_at(vma->file, frame->kva, read_bytes,
+                          vma_page_offset(vma, page->va)) != (int)read_bytes) {
             lock_release(&file_swap_lock);
             return false;
         }
-        pml4_set_dirty(thread_current()->pml4, page->va, 0);
+        lock_release(&file_swap_lock);
+    } else if (vma->type & VM_TEXT)
+        text_drop_cnt++;
+
+    lock_acquire(&frame_lock);
+    while (!list_empty(&frame->rmap)) {
+        struct page *p = list_entry(list_pop_front(&frame->rmap), struct page, rmap_elem);
+        p->frame = NULL;
     }
-    pml4_clear_page(thread_current()->pml4, page->va);
-    page->frame->page = NULL;
-    page->frame = NULL;
-    lock_release(&file_swap_lock);
+    frame->ref_count = 0;
+    frame->page = NULL;
+    lock_release(&frame_lock);
     return true;
 }
 
-/* Destory the file backed page. PAGE will be freed by the caller. */
-static void file_backed_destroy(struct page *page) {
-    struct file_page *file_page UNUSED = &page->file;
-    struct load_info *info = page->uninit.aux;
+/* Writes resident PAGE back to its file if it is dirty in PML4. */
+static void
+file_page_writeback(struct page *page, uint64_t *pml4) {
+    struct vma *vma = page->vma;
 
     lock_acquire(&file_swap_lock);
-    if (pml4_is_dirty(thread_current()->pml4, page->va)) {
-        if (file_write_at(info->file, page->frame->kva, info->page_read_bytes, info->offset) != (int)info->page_read_bytes) {
-            lock_release(&file_swap_lock);
-            return false;
-        }
-        pml4_set_dirty(thread_current()->pml4, page->va, 0);
+    if (pml4_is_dirty(pml4, page->va)) {
+        file_write_at(vma->file, page->frame->kva,
+                      vma_page_read_bytes(vma, page->va),
+                      vma_page_offset(vma, page->va));
+        pml4_set_dirty(pml4, page->va, 0);
     }
     lock_release(&file_swap_lock);
+}
 
-    if (page->frame && page->frame->page == page) {
-        lock_acquire(&file_swap_lock);
-        free_frame(page->frame);
-        lock_release(&file_swap_lock);
-    }
+/* Destory the file backed page. PAGE will be freed by the caller. */
+static void file_backed_destroy(struct page *page) {
+    struct file_page *file_page UNUSED = &page->file;
+
+    if (page->frame == NULL)
+        return;
+
+    file_page_writeback(page, thread_current()->pml4);
+    free_frame(page);
     pml4_clear_page(thread_current()->pml4, page->va);
 }
 
-/* Do the mmap */
+/* Do the mmap.
+ * The whole mapping is a single region; its pages are created as they
+ * are touched. */
 void *
 do_mmap(void *addr, size_t length, int writable,
         struct file *file, off_t offset) {
-    void *ret = addr;
-    struct file *mapping_file = file_reopen(file);
-    size_t read_bytes = length;
-    size_t zero_bytes = PGSIZE - (length % PGSIZE);
-    while (read_bytes > 0 || zero_bytes > 0) {
-        size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-        size_t page_zero_bytes = PGSIZE - page_read_bytes;
-
-        /* TODO: Set up aux to pass information to the lazy_load_segment. */
-        struct load_info *info = malloc(sizeof *info);
-        if (!info)
-            return NULL;
-        info->file = mapping_file;
-        info->page_read_bytes = page_read_bytes;
-        info->page_zero_bytes = page_zero_bytes;
-        info->offset = offset;
-        if (!vm_alloc_page_with_initializer(VM_FILE, addr, writable, lazy_load_file, info)) {
-            return NULL;
-        }
-        /* Advance. */
-        read_bytes -= page_read_bytes;
-        if (!read_bytes) {
-            struct page *last_file_page = spt_find_page(&thread_current()->spt, addr);
-            last_file_page->is_last_file_page = true;
-        }
-        zero_bytes -= page_zero_bytes;
-        addr += PGSIZE;
-        offset += page_read_bytes;
+    struct supplemental_page_table *spt = &thread_current()->spt;
+    struct file *mapping_file;
+    struct vma *vma;
+
+    /* Keep clear of the stack, whose pages have no region. */
+    if (addr + length > (void *)(USER_STACK - STACK_MAX) || addr + length < addr)
+        return NULL;
+    if (spt_overlaps_vma(spt, addr, pg_round_up(addr + length)))
+        return NULL;
+
+    mapping_file = file_reopen(file);
+    if (!mapping_file)
+        return NULL;
+    vma = vma_create(addr, length, VM_FILE, writable, mapping_file, offset,
+                     length, lazy_load_file);
+    if (!vma) {
+        file_close(mapping_file);
+        return NULL;
     }
-    return ret;
+    spt_insert_vma(spt, vma);
+    return addr;
 }
 
-/* Do the munmap */
+/* Do the munmap.
+ * The dirty pages are written back in runs first, so destroying each
+ * touched page afterwards finds it clean. */
 void do_munmap(void *addr) {
-    struct page *page;
-    struct load_info *info;
-    size_t file_size;
-    off_t offset;
-    page = spt_find_page(&thread_current()->spt, addr);
+    struct supplemental_page_table *spt = &thread_current()->spt;
+    struct vma *vma = spt_find_vma(spt, addr);
+    struct tlb_batch batch;
 
-    if (!page)
+    if (!vma || vma->start != addr || VM_TYPE(vma->type) != VM_FILE
+        || (vma->type & VM_TEXT))
         return;
 
-    while (page) {
-        info = page->uninit.aux;
+    vm_prefetch_drain(thread_current());
+    file_vma_writeback(vma);
+    pml4_batch_begin(&batch, thread_current()->pml4);
+    while (!list_empty(&vma->pages)) {
+        struct page *page = list_entry(list_front(&vma->pages), struct page, vma_elem);
+        spt_remove_page(spt, page);
+    }
+    pml4_batch_end(&batch);
+    spt_remove_vma(spt, vma);
+    vma_destroy(vma);
+}
 
-        if (pml4_is_dirty(thread_current()->pml4, page->va)) {
-            lock_acquire(&file_swap_lock);
-            file_seek(info->file, info->offset);
-            file_write(info->file, page->frame->kva, info->page_read_bytes);
-            lock_release(&file_swap_lock);
-            pml4_set_dirty(thread_current()->pml4, page->va, 0);
-        }
-        pml4_clear_page(thread_current()->pml4, page->va);
-        /* Advance. */
+/* Writes the dirty pages of the file mappings in the LENGTH bytes at
+ * ADDR back to their files. The range must be page-aligned and lie
+ * wholly in regions of the current process; pages of other regions are
+ * left alone. Returns 0 on success, -1 on bad arguments. */
+int
+do_msync(void *addr, size_t length) {
+    struct thread *curr = thread_current();
+    struct supplemental_page_table *spt = &curr->spt;
+    void *end = pg_round_up(addr + length);
+    struct vma *vma;
+    void *va;
+
+    if (pg_ofs(addr) != 0 || length == 0 || end <= addr || !is_user_vaddr(end - 1))
+        return -1;
+    for (va = addr; va < end; va = vma->end)
+        if ((vma = spt_find_vma(spt, va)) == NULL)
+            return -1;
 
-        addr += PGSIZE;
-        spt_remove_page(&thread_current()->spt, page);
-        page = spt_find_page(&thread_current()->spt, addr);
+    for (va = addr; va < end; va = vma->end) {
+        vma = spt_find_vma(spt, va);
+        msync_cnt += file_writeback_range(vma, va, end);
     }
-    file_close(info->file);
+    return 0;
 }
 
+/* Loads a page of the mapping AUX from its file. */
 static bool
 lazy_load_file(struct page *page, void *aux) {
-    /* TODO: Load the segment from the file */
-    /* TODO: This called when the first page fault occurs on address VA. */
-    /* TODO: VA is available when calling this function. */
-    struct load_info *info = (struct load_info *)aux;
+    struct vma *vma = aux;
     uint8_t *kpage = page->frame->kva;
     if (kpage == NULL)
         return false;
-    lock_acquire(&file_swap_lock);
-    file_seek(info->file, info->offset);
 
     /* Load this page. */
-    file_read(info->file, kpage, info->page_read_bytes);
+    lock_acquire(&file_swap_lock);
+    file_read_at(vma->file, kpage, vma_page_read_bytes(vma, page->va),
+                 vma_page_offset(vma, page->va));
     lock_release(&file_swap_lock);
 
     return true;
-}
\ No newline at end of file
+}
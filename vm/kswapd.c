@@ -0,0 +1,88 @@
+/* kswapd.c: Background page-out daemon.
+ * The kswapd thread sleeps until the number of free user-pool pages drops
+ * below the low watermark, then evicts frames and gives them back to the
+ * pool until the high watermark is reached, so that page faults rarely
+ * have to evict, and wait for the swap disk, themselves. The watermarks
+ * are set at boot with "-wmark-low=COUNT" and "-wmark-high=COUNT". */
+
+#include "vm/kswapd.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "vm/vm.h"
+#include <stdio.h>
+
+size_t kswapd_low_wmark;
+size_t kswapd_high_wmark;
+
+/* Smallest default low watermark, one swap-out cluster. */
+#define KSWAPD_MIN_LOW 8
+
+static struct semaphore kswapd_sema; /* Upped to wake kswapd. */
+static bool kswapd_awake;            /* Reclaiming, or about to. */
+
+/* Statistics. */
+static long long kswapd_wakeups;    /* # of times kswapd woke up. */
+static long long background_cnt;    /* # of frames evicted by kswapd. */
+static long long direct_cnt;        /* # of frames evicted by faults. */
+
+static void kswapd(void *aux);
+
+/* Fills in the default watermarks and starts kswapd. */
+void kswapd_init(void)
+{
+    if (kswapd_low_wmark == 0)
+    {
+        kswapd_low_wmark = palloc_pool_size(PAL_USER) / 64;
+        if (kswapd_low_wmark < KSWAPD_MIN_LOW)
+            kswapd_low_wmark = KSWAPD_MIN_LOW;
+    }
+    if (kswapd_high_wmark <= kswapd_low_wmark)
+        kswapd_high_wmark = kswapd_low_wmark * 2;
+
+    sema_init(&kswapd_sema, 0);
+    if (thread_create("kswapd", PRI_DEFAULT, kswapd, NULL) == TID_ERROR)
+        PANIC("cannot start kswapd");
+}
+
+/* Wakes kswapd if free user pages have run below the low watermark. */
+void kswapd_poke(void)
+{
+    if (!kswapd_awake && palloc_free_cnt(PAL_USER) < kswapd_low_wmark)
+    {
+        kswapd_awake = true;
+        sema_up(&kswapd_sema);
+    }
+}
+
+/* Records that a page fault had to evict CNT frames itself. */
+void kswapd_note_direct(size_t cnt)
+{
+    direct_cnt += cnt;
+}
+
+/* Prints reclaim statistics. */
+void kswapd_print_stats(void)
+{
+    printf("Kswapd: %lld wakeups, %lld background reclaims, "
+           "%lld direct reclaims, watermarks %zu/%zu\n",
+           kswapd_wakeups, background_cnt, direct_cnt,
+           kswapd_low_wmark, kswapd_high_wmark);
+}
+
+/* The daemon. Stops early if nothing can be evicted, e.g. when the swap
+ * disk is full, and waits to be poked again. */
+static void kswapd(void *aux UNUSED)
+{
+    for (;;)
+    {
+        size_t freed;
+
+        sema_down(&kswapd_sema);
+        kswapd_wakeups++;
+        while (palloc_free_cnt(PAL_USER) < kswapd_high_wmark &&
+               (freed = vm_reclaim_frame()) > 0)
+            background_cnt += freed;
+        kswapd_awake = false;
+    }
+}
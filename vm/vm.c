@@ -1,15 +1,126 @@
 /* vm.c: Generic interface for virtual memory objects. */
 
 #include "vm/vm.h"
+#include "devices/timer.h"
+#include "intrinsic.h"
 #include "threads/malloc.h"
 #include "threads/mmu.h"
 #include "vm/file.h"
 #include "vm/inspect.h"
+#include "vm/evict.h"
+#include "vm/kswapd.h"
+#include "vm/vma.h"
+#include "vm/zswap.h"
+#include "lib/kernel/bitmap.h"
+#include <inttypes.h>
+#include <madvise.h>
+#include <mstat.h>
+#include <round.h>
+#include <stdio.h>
 #include <string.h>
 
-struct list frame_list;
 struct lock frame_lock;
+/* Broadcast under frame_lock whenever a frame stops being evicted or
+ * loaded. One for all frames: a frame may be freed while a thread waits
+ * for it. */
+static struct condition frame_settled;
 static int count = 0;
+
+/* Number of anonymous victims swapped out together. */
+#define EVICT_CLUSTER 8
+
+/* The frame that never-written anonymous pages map on a read fault. It is
+ * always mapped read-only, has no reverse map, is never handed to the
+ * replacement policy and is never freed; the first write to such a page
+ * goes through vm_handle_wp(). */
+static struct frame zero_frame;
+static long long zero_map_cnt; /* # of read faults served by zero_frame. */
+static long long zero_cow_cnt; /* # of writes that left zero_frame. */
+
+/* Anonymous pages frozen at fork. Fork moves the parent's anonymous
+ * pages out of its table into a snapshot shared by parent and child,
+ * instead of duplicating every page descriptor and PTE. Each process
+ * takes a page back out of the snapshot the first time it looks the page
+ * up: a copy of the descriptor while others may still need the page, the
+ * descriptor itself once nobody else can see it. Frozen pages have no
+ * owner and are mapped nowhere, but stay in their frame's reverse map and
+ * can be evicted as usual.
+ * A process that forks again stacks a new snapshot on top of its old
+ * one, which then holds the old one in its place. Each frozen page counts
+ * the holders of its snapshot that have yet to thaw it, and lets go of
+ * its frame or swap slot when the last one does or goes away. Snapshots
+ * are only touched with snapshot_lock held, which is taken before
+ * frame_lock. */
+struct spt_snapshot
+{
+    struct hash pages;           /* Frozen pages, by address. */
+    int refs;                    /* Page tables and snapshots above it. */
+    struct spt_snapshot *parent; /* Older snapshot below this one. */
+};
+static struct lock snapshot_lock;
+static long long fork_cnt;          /* # of forks. */
+static long long frozen_cnt;        /* # of pages frozen by them. */
+static long long thaw_copy_cnt;     /* # of descriptors copied on touch. */
+static long long thaw_take_cnt;     /* # of descriptors taken back. */
+
+size_t fault_around_pages = 16;
+static long long around_mapped_cnt; /* # of pages mapped by fault-around. */
+static long long around_saved_cnt;  /* # of those that were then used. */
+
+bool huge_pages = true;
+static long long huge_map_cnt; /* # of 2 MB mappings installed. */
+
+size_t stack_red_zone = 128;
+size_t stack_growth_pages = 4;
+static long long stack_grow_cnt;   /* # of faults that grew a stack. */
+static long long stack_page_cnt;   /* # of stack pages they added. */
+static long long stack_claim_cnt;  /* # of those mapped ahead of use. */
+static long long stack_kill_cnt;   /* # of faults past the stack limit. */
+
+/* Latencies of the faults of every process, see vm_try_handle_fault(). */
+static struct faultstat fault_stats;
+static const char *fault_class_names[FAULT_CLASS_CNT] = {
+    "uninit", "swap-in", "file", "cow", "stack", "zero",
+};
+
+/* Ticks between two working-set samples of a process. */
+#define WS_INTERVAL 50
+
+/* Memory use of the last processes to exit, printed at power off. */
+#define MSTAT_LOG_SIZE 16
+struct mstat_record
+{
+    char name[16];
+    tid_t tid;
+    struct mstat st;
+    uint64_t faults[FAULT_CLASS_CNT];
+};
+static struct mstat_record mstat_log[MSTAT_LOG_SIZE];
+static size_t mstat_log_cnt; /* # of processes recorded, ever. */
+
+/* Background loading for MADV_WILLNEED. madvise() gives each page a
+ * frame and queues it; the prefetchd thread reads the contents in and
+ * hands the frame to the replacement policy, so that the first touch
+ * only has to map it. Until then the frame is pinned like any other
+ * half-loaded frame. Pages and regions of a process are only torn down
+ * after vm_prefetch_drain(). */
+struct prefetch_job
+{
+    struct page *page;     /* Page to load, with its frame attached. */
+    struct thread *owner;  /* Process that asked for it. */
+    struct list_elem elem; /* Element in prefetch_queue. */
+};
+static struct list prefetch_queue;
+static struct lock prefetch_lock;
+static struct semaphore prefetch_sema;   /* Upped once per queued job. */
+static struct condition prefetch_done;   /* Signalled as jobs finish. */
+static long long prefetch_cnt;           /* # of pages queued. */
+static long long prefetch_hit_cnt;       /* # of those mapped on touch. */
+static long long dontneed_cnt;           /* # of pages dropped. */
+static void prefetchd(void *aux);
+
+/* Pages a MADV_SEQUENTIAL reader keeps resident behind the fault. */
+#define SEQ_LAG 8
 /* Initializes the virtual memorstruct lock frame_lock;y subsystem by invoking
  * each subsystem's intialize codes. */
 void vm_init(void)
@@ -22,8 +133,20 @@ void vm_init(void)
     register_inspect_intr();
     /* DO NOT MODIFY UPPER LINES. */
     /* TODO: Your code goes here. */
-    list_init(&frame_list);
     lock_init(&frame_lock);
+    cond_init(&frame_settled);
+    lock_init(&snapshot_lock);
+    zero_frame.kva = palloc_get_page(PAL_ZERO | PAL_ASSERT);
+    list_init(&zero_frame.rmap);
+    evict_init();
+    kswapd_init();
+
+    list_init(&prefetch_queue);
+    lock_init(&prefetch_lock);
+    sema_init(&prefetch_sema, 0);
+    cond_init(&prefetch_done);
+    if (thread_create("prefetchd", PRI_DEFAULT, prefetchd, NULL) == TID_ERROR)
+        PANIC("cannot start prefetchd");
 }
 
 /* Get the type of the page. This function is useful if you want to know the
@@ -44,9 +167,28 @@ enum vm_type page_get_type(struct page *page)
 /* Helpers */
 static struct frame *vm_get_victim(void);
 static bool vm_do_claim_page(struct page *page);
-static struct frame *vm_evict_frame(void);
+static bool vm_is_shared_file(struct page *page);
+static bool vm_share_file_frame(struct page *page, struct frame *frame,
+                                bool *succ);
+static bool vm_is_zero_fill(struct page *page);
+static bool vm_map_zero_page(struct page *page);
+static void vm_fault_around(struct supplemental_page_table *spt,
+                            struct page *page);
+static void vm_settle_around(struct page *page, uint64_t *pml4);
+static bool vm_map_prefetched(struct page *page);
+static void vm_seq_advance(struct supplemental_page_table *spt,
+                           struct vma *vma, void *va);
+static bool vm_huge_eligible(struct page *page);
+static bool vm_claim_huge(struct page *page);
+static bool spt_freeze(struct supplemental_page_table *dst,
+                       struct supplemental_page_table *src);
+static struct page *spt_thaw(struct supplemental_page_table *spt, void *va);
+static void snapshot_put(struct spt_snapshot *snap, struct hash *shadow);
+static void snapshot_destroy_page(struct hash_elem *e, void *aux);
+static struct frame *vm_evict_frame(size_t *freed);
 static void hash_destroy_support(struct hash_elem *e, void *aux);
-static void write_contents(struct page *page);
+static void frame_rmap_add(struct frame *frame, struct page *page);
+static void frame_rmap_remove(struct frame *frame, struct page *page);
 
 /* Create the pending page object with initializer. If you want to create a
  * page, do not create it directly and make it through this function or
@@ -59,9 +201,13 @@ bool vm_alloc_page_with_initializer(enum vm_type type, void *upage,
     ASSERT(VM_TYPE(type) != VM_UNINIT)
 
     struct supplemental_page_table *spt = &thread_current()->spt;
+    struct page key;
 
-    /* Check wheter the upage is already occupied or not. */
-    if (spt_find_page(spt, upage) == NULL)
+    /* Check wheter the upage is already occupied or not. A page frozen in
+     * a snapshot does not count; the new page hides it from this process
+     * (see vm_madvise()). */
+    key.va = pg_round_down(upage);
+    if (hash_find(&spt->pages, &key.hash_elem) == NULL)
     {
         /* TODO: Create the page, fetch the initialier according to the VM type,
          * TODO: and then create "uninit" page struct by calling uninit_new. You
@@ -83,6 +229,7 @@ bool vm_alloc_page_with_initializer(enum vm_type type, void *upage,
         }
         page->writable = writable;
         page->original_writable = writable;
+        page->owner = thread_current();
 
         /* TODO: Insert the page into the spt. */
         return spt_insert_page(spt, page);
@@ -101,12 +248,48 @@ struct page *spt_find_page(struct supplemental_page_table *spt UNUSED,
     struct hash_elem *find_elem = hash_find(&spt->pages, &_page.hash_elem);
     /* TODO: Fill this function. */
     if (!find_elem)
-        return NULL;
+        return spt->snap ? spt_thaw(spt, _page.va) : NULL;
 
     page = hash_entry(find_elem, struct page, hash_elem);
     return page;
 }
 
+/* Creates the page at VA in region VMA of the current process, to be
+ * loaded on first touch. */
+static struct page *vma_alloc_page(struct supplemental_page_table *spt,
+                                   struct vma *vma, void *va)
+{
+    vm_initializer *init = vma->init;
+    struct page *page;
+
+    va = pg_round_down(va);
+    /* Nothing to load; see vm_is_zero_fill(). */
+    if (VM_TYPE(vma->type) == VM_ANON && vma_page_read_bytes(vma, va) == 0)
+        init = NULL;
+    if (!vm_alloc_page_with_initializer(vma->type, va, vma->writable, init,
+                                        vma))
+        return NULL;
+    page = spt_find_page(spt, va);
+    page->vma = vma;
+    list_push_back(&vma->pages, &page->vma_elem);
+    return page;
+}
+
+/* Find VA from spt, creating its page if VA lies in a region that has
+ * not been touched there yet. Return NULL if VA is not mapped. */
+struct page *spt_get_page(struct supplemental_page_table *spt, void *va)
+{
+    struct page *page = spt_find_page(spt, va);
+    struct vma *vma;
+
+    if (page)
+        return page;
+    vma = spt_find_vma(spt, va);
+    if (!vma)
+        return NULL;
+    return vma_alloc_page(spt, vma, va);
+}
+
 /* Insert PAGE into spt with validation. */
 bool spt_insert_page(struct supplemental_page_table *spt UNUSED,
                      struct page *page UNUSED)
@@ -118,92 +301,264 @@ bool spt_insert_page(struct supplemental_page_table *spt UNUSED,
 void spt_remove_page(struct supplemental_page_table *spt, struct page *page)
 {
     hash_delete(&spt->pages, &page->hash_elem);
+    if (page->vma)
+        list_remove(&page->vma_elem);
+    vm_settle_around(page, thread_current()->pml4);
+    evict_forget(page);
     vm_dealloc_page(page);
     return true;
 }
 
-/* Get the struct frame, that will be evicted. */
+/* Get the struct frame, that will be evicted.
+ * The replacement policy (see evict.c) chooses it and lets go of it, and
+ * it is marked as evicting so that free_frame() leaves it to us. */
 static struct frame *vm_get_victim(void)
 {
     /* TODO: The policy for eviction is up to you. */
-    struct list_elem *e;
-    struct frame *cur;
+    struct frame *victim;
     lock_acquire(&frame_lock);
-    for (e = list_begin(&frame_list); e != list_end(&frame_list);)
-    {
-        cur = list_entry(e, struct frame, elem);
-        if (pml4_is_accessed(thread_current()->pml4, cur->page->va))
-            pml4_set_accessed(thread_current()->pml4, cur->page->va, 0);
-        else
-        {
-            lock_release(&frame_lock);
-            return cur;
-        }
+    victim = evict_pick();
+    if (victim)
+        victim->evicting = true;
+    lock_release(&frame_lock);
+    return victim;
+}
 
-        if (e->next == list_end(&frame_list))
-            e = list_begin(&frame_list);
-        else
-            e = list_next(e);
-    }
+/* Reclaims victim FRAME, whose contents are now out of memory, for the
+ * caller. */
+static void vm_reset_frame(struct frame *frame)
+{
+    ASSERT(list_empty(&frame->rmap));
+    lock_acquire(&frame_lock);
+    if (frame->inode != NULL)
+        file_index_remove(frame);
+    frame->page = NULL;
+    frame->ref_count = 0;
+    frame->evicting = false;
+    frame_wake_waiters();
     lock_release(&frame_lock);
-    return NULL;
+}
+
+/* Hands victim FRAME back to the replacement policy. */
+static void vm_putback_frame(struct frame *frame)
+{
+    lock_acquire(&frame_lock);
+    frame->evicting = false;
+    evict_putback(frame);
+    frame_wake_waiters();
+    lock_release(&frame_lock);
+}
+
+/* Returns true if victim FRAME can join a swap-out cluster. */
+static bool vm_is_anon_victim(struct frame *frame)
+{
+    struct page *page = frame->page;
+    return page != NULL && page_get_type(page) == VM_ANON;
 }
 
 /* Evict one page and return the corresponding frame.
- * Return NULL on error.*/
-static struct frame *vm_evict_frame(void)
+ * Return NULL on error.
+ * Anonymous victims are taken EVICT_CLUSTER at a time and written to
+ * contiguous swap slots in one pass; the first frame is returned and the
+ * rest go back to the user pool for the faults that follow. Stores the
+ * number of frames evicted, the returned one included, in *FREED. */
+static struct frame *vm_evict_frame(size_t *freed)
 {
     struct frame *victim UNUSED = vm_get_victim();
+    struct frame *cluster[EVICT_CLUSTER];
+    size_t cnt = 1, done;
+
     /* TODO: swap out the victim and return the evicted frame. */
+    *freed = 0;
     if (!victim)
         return NULL;
-    if (swap_out(victim->page))
+
+    /* Every mapper may have gone away while we were picking it. */
+    if (!vm_is_anon_victim(victim))
     {
-        victim->page = NULL;
-        memset(victim->kva, 0, PGSIZE);
-        victim->ref_count = 1;
-        return victim;
+        if (victim->page == NULL || swap_out(victim->page))
+        {
+            vm_reset_frame(victim);
+            memset(victim->kva, 0, PGSIZE);
+            *freed = 1;
+            return victim;
+        }
+        vm_putback_frame(victim);
+        return NULL;
     }
-    return NULL;
+
+    cluster[0] = victim;
+    while (cnt < EVICT_CLUSTER)
+    {
+        struct frame *f = vm_get_victim();
+        if (!f)
+            break;
+        if (!vm_is_anon_victim(f))
+        {
+            vm_putback_frame(f);
+            break;
+        }
+        cluster[cnt++] = f;
+    }
+
+    done = anon_swap_out_cluster(cluster, cnt);
+    for (size_t i = done; i < cnt; i++)
+        vm_putback_frame(cluster[i]);
+    if (done == 0)
+        return NULL;
+
+    for (size_t i = 1; i < done; i++)
+    {
+        vm_reset_frame(cluster[i]);
+        palloc_free_page(cluster[i]->kva);
+        free(cluster[i]);
+    }
+    vm_reset_frame(victim);
+    memset(victim->kva, 0, PGSIZE);
+    *freed = done;
+    return victim;
 }
 
 /* palloc() and get frame. If there is no available page, evict the page
  * and return it. This always return valid address. That is, if the user pool
  * memory is full, this function evicts the frame to get the available memory
- * space.*/
+ * space.
+ * The returned frame has no mappers and is not known to the replacement
+ * policy yet; the caller links it with frame_rmap_add() and evict_admit()
+ * once the contents are in place, so that it cannot be chosen as a victim
+ * half-loaded. */
 static struct frame *vm_get_frame(void)
 {
     struct frame *frame = calloc(1, sizeof *frame);
+    size_t freed;
+
+    if (!frame)
+        return NULL;
     frame->kva = palloc_get_page(PAL_ZERO | PAL_USER);
-    frame->ref_count = 1;
+    list_init(&frame->rmap);
     /* TODO: Fill this function. */
     if (frame->kva == NULL)
     {
-        frame = vm_evict_frame();
+        free(frame);
+        kswapd_poke();
+        frame = vm_evict_frame(&freed);
+        kswapd_note_direct(freed);
         if (!frame)
             return NULL;
     }
     else
-    {
-        lock_acquire(&frame_lock);
-        list_push_back(&frame_list, &frame->elem);
-        lock_release(&frame_lock);
-    }
+        kswapd_poke();
 
     ASSERT(frame != NULL);
     ASSERT(frame->page == NULL);
     return frame;
 }
 
-/* Growing the stack. */
-static void vm_stack_growth(void *addr UNUSED)
+/* Evicts a victim, or a cluster of them, and gives the frames back to
+ * the user pool. Returns the number of frames freed, 0 if there was
+ * nothing to evict. */
+size_t vm_reclaim_frame(void)
+{
+    size_t freed;
+    struct frame *frame = vm_evict_frame(&freed);
+    if (!frame)
+        return 0;
+    palloc_free_page(frame->kva);
+    free(frame);
+    return freed;
+}
+
+/* Returns true if a fault at ADDR, which has no page, is an access to
+ * the user stack: between the red zone below the stack pointer and the
+ * top of the stack. */
+static bool vm_is_stack_access(void *addr)
+{
+    struct thread *curr = thread_current();
+
+    return addr < curr->stack_bottom && addr < (void *)USER_STACK &&
+           (uint64_t)addr + stack_red_zone >= curr->user_rsp;
+}
+
+/* Grows the stack down to cover ADDR and stack_growth_pages - 1 more
+ * pages below it, within the process's stack limit. The page at ADDR is
+ * claimed; the ones below are claimed ahead of use while memory is
+ * plentiful, so that deep recursion does not fault on every page.
+ * Returns false if ADDR lies past the limit or cannot be backed. */
+static bool vm_stack_growth(void *addr)
 {
-    vm_alloc_page(VM_ANON | VM_MARKER_0, pg_round_down(addr), true);
+    struct thread *curr = thread_current();
+    void *limit = (void *)USER_STACK - curr->stack_limit;
+    void *fault_va = pg_round_down(addr);
+    void *bottom, *va;
+
+    if (fault_va < limit)
+    {
+        stack_kill_cnt++;
+        return false;
+    }
+    bottom = fault_va;
+    if (stack_growth_pages > 1)
+        bottom -= (stack_growth_pages - 1) * PGSIZE;
+    if (bottom < limit || bottom > fault_va)
+        bottom = limit;
+
+    stack_grow_cnt++;
+    for (va = curr->stack_bottom - PGSIZE; va >= bottom; va -= PGSIZE)
+    {
+        if (!vm_alloc_page(VM_ANON | VM_MARKER_0, va, true))
+            return false;
+        curr->stack_bottom = va;
+        stack_page_cnt++;
+    }
+    if (!vm_claim_page(fault_va))
+        return false;
 
-    if (!vm_claim_page(addr))
+    for (va = fault_va - PGSIZE; va >= bottom; va -= PGSIZE)
     {
-        PANIC("todo claim false");
+        if (palloc_free_cnt(PAL_USER) <= kswapd_high_wmark)
+            break;
+        if (!vm_claim_page(va))
+            break;
+        stack_claim_cnt++;
     }
+    return true;
+}
+
+/* Limits the user stack of the current process to SIZE bytes, rounded
+ * up to whole pages. The stack it already has must fit, and SIZE may
+ * not exceed STACK_MAX. Returns 0 on success, -1 on failure. */
+int vm_set_stack_limit(size_t size)
+{
+    struct thread *curr = thread_current();
+
+    if (size > STACK_MAX)
+        return -1;
+    size = ROUND_UP(size, PGSIZE);
+    if (size < USER_STACK - (uint64_t)curr->stack_bottom)
+        return -1;
+    curr->stack_limit = size;
+    return 0;
+}
+
+/* Returns true if PAGE is anonymous memory that has never been written,
+ * so that its contents are all zeros. */
+static bool vm_is_zero_fill(struct page *page)
+{
+    return page->operations->type == VM_UNINIT &&
+           VM_TYPE(page->uninit.type) == VM_ANON && page->uninit.init == NULL;
+}
+
+/* Maps zero_frame read-only at never-written anonymous PAGE. */
+static bool vm_map_zero_page(struct page *page)
+{
+    /* Only turns PAGE into an anonymous page; zero_frame is not touched. */
+    if (!swap_in(page, zero_frame.kva))
+        return false;
+    page->frame = &zero_frame;
+    page->writable = false;
+    zero_map_cnt++;
+    return pml4_set_page(thread_current()->pml4, page->va, zero_frame.kva,
+                         false);
 }
 
 /* Handle the fault on write_protected page */
@@ -212,17 +567,28 @@ static bool vm_handle_wp(struct page *page UNUSED)
     if (!page->original_writable)
         return false;
 
-    if (page->frame->ref_count > 1)
+    /* Frames of shared file pages are written in place. */
+    if (page->frame == &zero_frame ||
+        (page->frame->ref_count > 1 && page->frame->inode == NULL))
     {
         // 물리 frame 새로 할당
         struct frame *new_frame = vm_get_frame();
         if (!new_frame)
             return false;
-        memcpy(new_frame->kva, page->frame->kva, PGSIZE);
         lock_acquire(&frame_lock);
-        page->frame->ref_count--;
-        page->frame = new_frame;
-        page->frame->ref_count = 1;
+        if (page->frame == &zero_frame)
+        {
+            /* New frames come zeroed. */
+            page->frame = NULL;
+            zero_cow_cnt++;
+        }
+        else
+        {
+            memcpy(new_frame->kva, page->frame->kva, PGSIZE);
+            frame_rmap_remove(page->frame, page);
+        }
+        frame_rmap_add(new_frame, page);
+        evict_admit(new_frame);
         lock_release(&frame_lock);
         pml4_clear_page(thread_current()->pml4, page->va);
     }
@@ -232,167 +598,1098 @@ static bool vm_handle_wp(struct page *page UNUSED)
     return true;
 }
 
-/* Return true on success */
-bool vm_try_handle_fault(struct intr_frame *f UNUSED, void *addr UNUSED,
-                         bool user UNUSED, bool write UNUSED,
-                         bool not_present UNUSED)
+/* Returns the class under which a fault on existing PAGE is timed. */
+static enum fault_class vm_fault_class(struct page *page, bool write,
+                                       bool not_present)
+{
+    if (write && !not_present)
+        return FAULT_COW;
+    if (vm_is_zero_fill(page))
+        return FAULT_ZERO;
+    switch (page->operations->type)
+    {
+    case VM_UNINIT:
+        if (VM_TYPE(page->uninit.type) == VM_FILE &&
+            !(page->uninit.type & VM_TEXT))
+            return FAULT_FILE;
+        return FAULT_UNINIT;
+    case VM_ANON:
+        return FAULT_SWAP_IN;
+    default:
+        return FAULT_FILE;
+    }
+}
+
+/* Adds a fault of CLASS that took CYCLES to the histograms and to the
+ * current process's counts. */
+static void vm_fault_record(enum fault_class class, uint64_t cycles)
+{
+    int bucket = 0;
+    enum intr_level old_level;
+
+    while (bucket < FAULT_HIST_BUCKETS - 1 && cycles >> (10 + bucket) != 0)
+        bucket++;
+    old_level = intr_disable();
+    fault_stats.count[class]++;
+    fault_stats.cycles[class] += cycles;
+    fault_stats.hist[class][bucket]++;
+    intr_set_level(old_level);
+    thread_current()->fault_cnt[class]++;
+}
+
+/* Waits until the frame of PAGE, which the current process cannot map
+ * yet, is no longer being evicted or loaded by another thread. Blocking
+ * instead of yielding lets that thread run even if its priority is
+ * lower. If PAGE still has the frame afterwards and nothing else is to
+ * be done with it, it is mapped again. Returns true so that the access
+ * is retried. */
+static bool vm_wait_frame(struct page *page)
+{
+    struct frame *frame;
+
+    lock_acquire(&frame_lock);
+    while ((frame = page->frame) != NULL &&
+           (frame->evicting || frame->loading))
+        cond_wait(&frame_settled, &frame_lock);
+    /* An eviction that was given up leaves the page unmapped. */
+    if (frame != NULL && page->prefetch == PREFETCH_NONE)
+        pml4_set_page(thread_current()->pml4, page->va, frame->kva,
+                      frame != &zero_frame && page->writable);
+    lock_release(&frame_lock);
+    return true;
+}
+
+/* Handles a fault at ADDR. Sets *CLASS to the kind of fault if it is
+ * one that is timed. Return true on success */
+static bool vm_handle_fault(void *addr, bool user, bool write,
+                            bool not_present, enum fault_class *class)
 {
-    struct supplemental_page_table *spt UNUSED = &thread_current()->spt;
+    struct supplemental_page_table *spt = &thread_current()->spt;
     struct page *page = NULL;
 
-    page = spt_find_page(spt, addr);
+    page = spt_get_page(spt, addr);
 
-    if (!page)
-    {
+    /* Loaded by prefetchd, and only waiting to be mapped. */
+    if (page && page->frame && not_present &&
+        page->prefetch == PREFETCH_READY)
+        return vm_map_prefetched(page);
 
-        if (pg_round_down(addr) <= USER_STACK + PGSIZE - (1 << 20))
-            return false;
+    /* The frame is being swapped out by somebody else, or filled in by
+     * prefetchd; let it finish and retry the access. */
+    if (page && page->frame && not_present)
+        return vm_wait_frame(page);
 
-        page = spt_find_page(spt, pg_round_up(addr));
+    if (user)
+        vm_sample_ws();
 
-        if (page && ((page->uninit.type) & VM_MARKER_0) &&
-            addr == thread_current()->user_rsp)
-        {
-            vm_stack_growth(addr);
-            return true;
-        }
+    /* Past the stack limit, the process is killed by our caller. */
+    if (!page)
+    {
+        *class = FAULT_STACK;
+        return vm_is_stack_access(addr) && vm_stack_growth(addr);
+    }
+
+    if (page->prefetch == PREFETCH_FAILED)
         return false;
+    *class = vm_fault_class(page, write, not_present);
+
+    if (not_present)
+    {
+        struct vma *vma = spt_find_vma(spt, page->va);
+        if (vma && vma->advice == MADV_SEQUENTIAL)
+            vm_seq_advance(spt, vma, page->va);
     }
 
     if (write && !not_present)
         return vm_handle_wp(page); // copy-on-wrtie 구현하면 여기서 함수 호출;
 
-    return vm_do_claim_page(page);
-}
+    if (!write && vm_is_zero_fill(page))
+        return vm_map_zero_page(page);
 
-/* Free the page.
- * DO NOT MODIFY THIS FUNCTION. */
-void vm_dealloc_page(struct page *page)
-{
-    destroy(page);
-    free(page);
+    if (vm_huge_eligible(page))
+        return vm_claim_huge(page);
+
+    if (page->operations->type != VM_UNINIT || !page->vma || !page->vma->file)
+        return vm_do_claim_page(page);
+
+    if (!vm_do_claim_page(page))
+        return false;
+    vm_fault_around(spt, page);
+    return true;
 }
 
-/* Claim the page that allocate on VA. */
-bool vm_claim_page(void *va UNUSED)
+/* Return true on success.
+ * Faults that are handled are timed with the TSC, by class. */
+bool vm_try_handle_fault(struct intr_frame *f UNUSED, void *addr UNUSED,
+                         bool user UNUSED, bool write UNUSED,
+                         bool not_present UNUSED)
 {
-    struct thread *curr = thread_current();
-    struct page *page = spt_find_page(&curr->spt, va);
-    /* TODO: Fill this function */
-    if (!page)
-        return false;
-    return vm_do_claim_page(page);
+    enum fault_class class = FAULT_CLASS_CNT;
+    uint64_t start = rdtsc();
+    bool success;
+
+    success = vm_handle_fault(addr, user, write, not_present, &class);
+    if (success && class != FAULT_CLASS_CNT)
+        vm_fault_record(class, rdtsc() - start);
+    return success;
 }
 
-/* Claim the PAGE and set up the mmu. */
-static bool vm_do_claim_page(struct page *page)
+/* Loads and maps the untouched pages of PAGE's region that lie in the
+ * aligned window of fault_around_pages pages around it, so that a
+ * sequential scan takes one fault per window instead of one per page.
+ * Stops early rather than make kswapd work for pages nobody asked
+ * for yet. */
+static void vm_fault_around(struct supplemental_page_table *spt,
+                            struct page *page)
 {
-    struct frame *frame = vm_get_frame();
+    struct vma *vma = page->vma;
     struct thread *curr = thread_current();
-    bool succ;
-    /* Set links */
-    frame->page = page;
-    page->frame = frame;
+    void *start, *end, *va;
 
-    /* TODO: Insert page table entry to map page's VA to frame's PA. */
-    succ = pml4_set_page(curr->pml4, page->va, frame->kva, page->writable);
-    if (!succ)
-        return succ;
+    if (fault_around_pages <= 1)
+        return;
+    start = (void *)(pg_no(page->va) / fault_around_pages * fault_around_pages * PGSIZE);
+    end = start + fault_around_pages * PGSIZE;
+    if (start < vma->start)
+        start = vma->start;
+    if (end > vma->end)
+        end = vma->end;
+
+    for (va = start; va < end; va += PGSIZE)
+    {
+        struct page *p;
 
-    return swap_in(page, frame->kva);
+        /* Zero-filled pages are left to the zero page. */
+        if (va == page->va || vma_page_read_bytes(vma, va) == 0 ||
+            spt_find_page(spt, va))
+            continue;
+        if (palloc_free_cnt(PAL_USER) <= kswapd_high_wmark)
+            break;
+        p = vma_alloc_page(spt, vma, va);
+        if (!p || !vm_do_claim_page(p))
+            break;
+        p->around = true;
+        curr->around_mapped++;
+        around_mapped_cnt++;
+    }
 }
 
-/* Initialize new supplemental page table */
-void supplemental_page_table_init(struct supplemental_page_table *spt UNUSED)
+/* Returns true if untouched PAGE should be brought in as part of a
+ * 2 MB page: the aligned 2 MB block around it lies inside its
+ * anonymous region. */
+static bool vm_huge_eligible(struct page *page)
 {
-    hash_init(&spt->pages, page_hash, page_less, NULL);
+    struct vma *vma = page->vma;
+    uint8_t *base = (uint8_t *)((uint64_t)page->va & ~(HUGE_PGSIZE - 1));
+
+    return huge_pages && vma && page->operations->type == VM_UNINIT &&
+           VM_TYPE(vma->type) == VM_ANON && (void *)base >= vma->start &&
+           (void *)(base + HUGE_PGSIZE) <= vma->end;
 }
 
-/* Copy supplemental page table from src to dst */
-bool supplemental_page_table_copy(struct supplemental_page_table *dst UNUSED,
-                                  struct supplemental_page_table *src UNUSED)
+/* Returns the start of the aligned run of the user pool that the 2 MB
+ * block around VA is being built in, found through the nearest page of
+ * the block that PML4 maps. Returns NULL if no page of the block is
+ * mapped yet, and sets *CONTIGUOUS to false if the one that is does not
+ * sit where the block's run would put it, so that the block can never
+ * be mapped as a whole. */
+static void *vm_huge_run(uint64_t *pml4, void *va, bool *contiguous)
 {
-    struct hash_iterator i;
-    hash_first(&i, &src->pages);
-    while (hash_next(&i))
+    uint8_t *base = (uint8_t *)((uint64_t)va & ~(HUGE_PGSIZE - 1));
+    size_t ofs = ((uint8_t *)va - base) / PGSIZE;
+
+    *contiguous = true;
+    for (size_t d = 1; d < HUGE_PGCNT; d++)
     {
-        struct page *src_page = hash_entry(hash_cur(&i), struct page, hash_elem);
-        struct page *dst_page;
-        enum vm_type src_type = VM_TYPE(src_page->operations->type);
+        size_t near[2] = {ofs - d, ofs + d};
 
-        if (src_type == VM_UNINIT)
+        for (int k = 0; k < 2; k++)
         {
-            if (!vm_alloc_page_with_initializer(
-                    src_page->uninit.type, src_page->va, src_page->writable,
-                    src_page->uninit.init, src_page->uninit.aux))
-            {
-                return false;
-            }
-            continue;
-        }
+            uint8_t *kva;
 
-        if (src_type == VM_FILE)
-        {
-            struct load_info *info = malloc(sizeof(struct load_info));
-            if (!info)
-                return false;
-            *info = *(struct load_info *)src_page->uninit.aux;
-            if (!vm_alloc_page_with_initializer(VM_FILE, src_page->va,
-                                                src_page->writable,
-                                                src_page->uninit.init, info))
+            /* Out of the block, including wrap-around below 0. */
+            if (near[k] >= HUGE_PGCNT)
+                continue;
+            kva = pml4_get_page(pml4, base + near[k] * PGSIZE);
+            if (kva == NULL)
+                continue;
+            kva -= near[k] * PGSIZE;
+            if (vtop(kva) % HUGE_PGSIZE != 0)
             {
-                free(info);
-                return false;
-            }
-        }
-        else
-        {
-            if (!vm_alloc_page(src_type, src_page->va, src_page->writable))
-            {
-                return false;
+                *contiguous = false;
+                return NULL;
             }
+            return kva;
         }
+    }
+    return NULL;
+}
 
-        dst_page = spt_find_page(dst, src_page->va);
-        if (dst_page == NULL)
-        {
-            return false;
-        }
-        dst_page->operations = src_page->operations;
-        dst_page->frame = src_page->frame;
-        dst_page->writable = false;
-        dst_page->original_writable = src_page->writable;
-        src_page->writable = false;
+/* Brings in PAGE, which vm_huge_eligible() accepted, with a frame at
+ * its place in an aligned 2 MB run of the user pool: the run that the
+ * rest of its block already uses, or a free one for the first page.
+ * Only this one page is allocated and zeroed. Once the last page of the
+ * block is in, the 512 translations are collapsed into one 2 MB mapping;
+ * whatever later clears one of them splits it back into a page table
+ * first (see threads/mmu.c). Falls back to a plain claim if the page
+ * of the run is taken. */
+static bool vm_claim_huge(struct page *page)
+{
+    struct thread *curr = thread_current();
+    uint8_t *base = (uint8_t *)((uint64_t)page->va & ~(HUGE_PGSIZE - 1));
+    size_t ofs = ((uint8_t *)page->va - base) / PGSIZE;
+    struct frame *frame;
+    bool contiguous, succ;
+    void *run = vm_huge_run(curr->pml4, page->va, &contiguous);
+    void *kva = contiguous
+                    ? palloc_get_huge_page(PAL_USER | PAL_ZERO, run, ofs)
+                    : NULL;
 
-        lock_acquire(&frame_lock);
-        src_page->frame->ref_count++;
-        lock_release(&frame_lock);
+    if (!kva)
+        return vm_do_claim_page(page);
+    frame = calloc(1, sizeof *frame);
+    if (!frame)
+    {
+        palloc_free_page(kva);
+        return vm_do_claim_page(page);
+    }
+    kswapd_poke();
+    frame->kva = kva;
+    list_init(&frame->rmap);
+    page->prefetch = PREFETCH_NONE;
 
-        if (!pml4_set_page(thread_current()->pml4, dst_page->va,
-                           dst_page->frame->kva, false))
-            return false;
+    lock_acquire(&frame_lock);
+    frame_rmap_add(frame, page);
+    lock_release(&frame_lock);
 
-        if (!pml4_set_page(thread_current()->parent_pml4, src_page->va,
-                           src_page->frame->kva, false))
-            return false;
-    }
-    return true;
+    succ = pml4_set_page(curr->pml4, page->va, frame->kva, page->writable) &&
+           swap_in(page, frame->kva);
+
+    lock_acquire(&frame_lock);
+    evict_admit(frame);
+    lock_release(&frame_lock);
+
+    if (succ && pml4_promote(curr->pml4, base))
+        huge_map_cnt++;
+    return succ;
 }
 
-/* Free the resource hold by the supplemental page table */
-void supplemental_page_table_kill(struct supplemental_page_table *spt UNUSED)
+/* Accounts for PAGE, mapped by fault-around, before it leaves PML4. */
+static void vm_settle_around(struct page *page, uint64_t *pml4)
 {
-    /* TODO: Destroy all the supplemental_page_table hold by thread and
-     * TODO: writeback all the modified contents to the storage. */
-    hash_clear(&spt->pages, hash_destroy_support);
+    if (page->around && pml4_is_accessed(pml4, page->va))
+    {
+        page->owner->around_saved++;
+        around_saved_cnt++;
+    }
+    page->around = false;
 }
 
-static void hash_destroy_support(struct hash_elem *e, void *aux)
+/* Maps PAGE, which prefetchd has loaded, on its first touch. If an
+ * evictor got to the frame first, the access is simply retried. */
+static bool vm_map_prefetched(struct page *page)
 {
-    struct page *p = hash_entry(e, struct page, hash_elem);
+    struct frame *frame;
+    bool succ = true;
 
-    vm_dealloc_page(p);
-}
+    lock_acquire(&frame_lock);
+    frame = page->frame;
+    if (frame != NULL && !frame->evicting)
+    {
+        page->prefetch = PREFETCH_NONE;
+        succ = pml4_set_page(thread_current()->pml4, page->va, frame->kva,
+                             page->writable);
+        prefetch_hit_cnt++;
+    }
+    lock_release(&frame_lock);
+    return succ;
+}
+
+/* Hands the resident pages of VMA, a MADV_SEQUENTIAL region, that lie
+ * more than SEQ_LAG pages behind the fault at VA to the evictor, ahead of
+ * everything the replacement policy holds. Each page is looked at once
+ * per pass; a fault behind the last pass starts a new one. */
+static void vm_seq_advance(struct supplemental_page_table *spt,
+                           struct vma *vma, void *va)
+{
+    void *limit, *p;
+
+    if (va < vma->seq_mark)
+        vma->seq_mark = vma->start;
+    if ((size_t)(va - vma->start) <= SEQ_LAG * PGSIZE)
+        return;
+    limit = va - SEQ_LAG * PGSIZE;
+
+    lock_acquire(&frame_lock);
+    for (p = vma->seq_mark; p < limit; p += PGSIZE)
+    {
+        struct hash_elem *e;
+        struct page key, *page;
+
+        key.va = p;
+        e = hash_find(&spt->pages, &key.hash_elem);
+        if (e == NULL)
+            continue;
+        page = hash_entry(e, struct page, hash_elem);
+        if (page->frame != NULL && page->frame != &zero_frame &&
+            page->prefetch != PREFETCH_PENDING)
+            evict_deactivate(page->frame);
+    }
+    lock_release(&frame_lock);
+    if (limit > vma->seq_mark)
+        vma->seq_mark = limit;
+}
+
+/* Queues the page at VA in SPT, the current process's table, for
+ * prefetchd, unless it is resident or needs no loading. Returns false if
+ * memory is too tight to go on. */
+static bool vm_prefetch_page(struct supplemental_page_table *spt, void *va)
+{
+    struct thread *curr = thread_current();
+    struct page *page = spt_find_page(spt, va);
+    struct prefetch_job *job;
+    struct frame *frame;
+    bool shared, succ;
+
+    if (page == NULL)
+    {
+        struct vma *vma = spt_find_vma(spt, va);
+
+        /* Zero-filled pages are left to the zero page. */
+        if (VM_TYPE(vma->type) == VM_ANON &&
+            vma_page_read_bytes(vma, va) == 0)
+            return true;
+        page = vma_alloc_page(spt, vma, va);
+        if (page == NULL)
+            return false;
+    }
+    if (page->frame != NULL || vm_is_zero_fill(page))
+        return true;
+    /* Somebody else has it in memory already; just map it. */
+    shared = vm_is_shared_file(page);
+    if (shared && vm_share_file_frame(page, NULL, &succ))
+        return succ;
+    if (palloc_free_cnt(PAL_USER) <= kswapd_high_wmark)
+        return false;
+
+    job = malloc(sizeof *job);
+    frame = job != NULL ? vm_get_frame() : NULL;
+    if (frame == NULL)
+    {
+        free(job);
+        return false;
+    }
+    if (shared && vm_share_file_frame(page, frame, &succ))
+    {
+        palloc_free_page(frame->kva);
+        free(frame);
+        free(job);
+        return succ;
+    }
+    lock_acquire(&frame_lock);
+    if (!shared)
+        frame_rmap_add(frame, page);
+    page->prefetch = PREFETCH_PENDING;
+    lock_release(&frame_lock);
+
+    job->page = page;
+    job->owner = curr;
+    lock_acquire(&prefetch_lock);
+    curr->prefetch_pending++;
+    list_push_back(&prefetch_queue, &job->elem);
+    lock_release(&prefetch_lock);
+    prefetch_cnt++;
+    sema_up(&prefetch_sema);
+    return true;
+}
+
+/* Waits until none of T's pages is queued for prefetchd any more. Must
+ * be called before T's pages or regions go away. */
+void vm_prefetch_drain(struct thread *t)
+{
+    lock_acquire(&prefetch_lock);
+    while (t->prefetch_pending > 0)
+        cond_wait(&prefetch_done, &prefetch_lock);
+    lock_release(&prefetch_lock);
+}
+
+/* The prefetch daemon. A page that cannot be loaded loses its frame and
+ * fails its first touch, as it would have on a plain fault. */
+static void prefetchd(void *aux UNUSED)
+{
+    for (;;)
+    {
+        struct prefetch_job *job;
+        struct page *page;
+        struct frame *frame;
+        bool succ;
+
+        sema_down(&prefetch_sema);
+        lock_acquire(&prefetch_lock);
+        job = list_entry(list_pop_front(&prefetch_queue),
+                         struct prefetch_job, elem);
+        lock_release(&prefetch_lock);
+
+        page = job->page;
+        frame = page->frame;
+        succ = swap_in(page, frame->kva);
+
+        lock_acquire(&frame_lock);
+        frame->loading = false;
+        frame_wake_waiters();
+        if (succ)
+        {
+            page->prefetch = PREFETCH_READY;
+            evict_admit(frame);
+        }
+        else
+        {
+            file_index_remove(frame);
+            frame_rmap_remove(frame, page);
+            page->frame = NULL;
+            page->prefetch = PREFETCH_FAILED;
+            palloc_free_page(frame->kva);
+            free(frame);
+        }
+        lock_release(&frame_lock);
+
+        lock_acquire(&prefetch_lock);
+        job->owner->prefetch_pending--;
+        cond_broadcast(&prefetch_done, &prefetch_lock);
+        lock_release(&prefetch_lock);
+        free(job);
+    }
+}
+
+/* Applies ADVICE, one of the MADV_* values, to the LENGTH bytes at ADDR,
+ * which must be page-aligned and lie wholly in regions of the current
+ * process. Returns 0 on success, -1 on bad arguments or if memory runs
+ * out.
+ * MADV_WILLNEED stops quietly when memory gets tight; it is only a
+ * hint. */
+int vm_madvise(void *addr, size_t length, int advice)
+{
+    struct thread *curr = thread_current();
+    struct supplemental_page_table *spt = &curr->spt;
+    void *end = pg_round_up(addr + length);
+    struct vma *vma;
+    void *va;
+
+    if (pg_ofs(addr) != 0 || length == 0 || end <= addr ||
+        !is_user_vaddr(end - 1))
+        return -1;
+    for (va = addr; va < end; va = vma->end)
+        if ((vma = spt_find_vma(spt, va)) == NULL)
+            return -1;
+
+    switch (advice)
+    {
+    case MADV_NORMAL:
+    case MADV_SEQUENTIAL:
+        for (va = addr; va < end; va = vma->end)
+        {
+            vma = spt_find_vma(spt, va);
+            vma->advice = advice;
+            vma->seq_mark = vma->start;
+        }
+        return 0;
+    case MADV_WILLNEED:
+        for (va = addr; va < end; va += PGSIZE)
+            if (!vm_prefetch_page(spt, va))
+                break;
+        return 0;
+    case MADV_DONTNEED:
+        /* The next touch loads the page afresh from its region. If the
+         * page was shared at fork, the old data is still frozen in a
+         * snapshot for the other side, and spt_find_page() would thaw it
+         * again; a fresh page put in its place right away hides it. */
+        vm_prefetch_drain(curr);
+        for (va = addr; va < end; va += PGSIZE)
+        {
+            struct page *page = spt_find_page(spt, va);
+
+            if (page != NULL)
+            {
+                spt_remove_page(spt, page);
+                dontneed_cnt++;
+                if (spt->snap &&
+                    !vma_alloc_page(spt, spt_find_vma(spt, va), va))
+                    return -1;
+            }
+        }
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+/* Free the page.
+ * DO NOT MODIFY THIS FUNCTION. */
+void vm_dealloc_page(struct page *page)
+{
+    destroy(page);
+    free(page);
+}
+
+/* Claim the page that allocate on VA. */
+bool vm_claim_page(void *va UNUSED)
+{
+    struct thread *curr = thread_current();
+    struct page *page = spt_get_page(&curr->spt, va);
+    /* TODO: Fill this function */
+    if (!page)
+        return false;
+    return vm_do_claim_page(page);
+}
+
+/* Returns true if PAGE belongs to a file mapping and shares its frame
+ * with every other mapping of the same part of the file. */
+static bool vm_is_shared_file(struct page *page)
+{
+    return page->vma != NULL && page_get_type(page) == VM_FILE &&
+           file_page_shareable(page->vma, page->va);
+}
+
+/* Maps PAGE, a shared file page, to the frame in the file page index
+ * that holds its part of the file, and returns true with the result of
+ * the mapping in *SUCC. Waits if that frame is still being read in or
+ * being evicted. If there is none, returns false, after linking PAGE to
+ * FRAME and publishing FRAME in the index, marked as loading, if FRAME
+ * is not NULL. */
+static bool vm_share_file_frame(struct page *page, struct frame *frame,
+                                bool *succ)
+{
+    struct vma *vma = page->vma;
+    struct inode *inode = file_get_inode(vma->file);
+    off_t ofs = vma_page_offset(vma, page->va);
+    struct frame *shared;
+
+    lock_acquire(&frame_lock);
+    while ((shared = file_index_lookup(inode, ofs)) != NULL &&
+           (shared->loading || shared->evicting))
+        cond_wait(&frame_settled, &frame_lock);
+    if (shared != NULL)
+    {
+        /* Only turns an untouched PAGE into a file page. */
+        if (page->operations->type == VM_UNINIT)
+            file_backed_initializer(page, page->uninit.type, shared->kva);
+        frame_rmap_add(shared, page);
+        /* Mapped with frame_lock held, so that it cannot be evicted
+         * before then. */
+        *succ = pml4_set_page(thread_current()->pml4, page->va, shared->kva,
+                              page->writable);
+        file_index_note_share(vma);
+    }
+    else if (frame != NULL)
+    {
+        frame_rmap_add(frame, page);
+        frame->loading = true;
+        file_index_insert(frame, inode, ofs);
+    }
+    lock_release(&frame_lock);
+    return shared != NULL;
+}
+
+/* Claim the PAGE and set up the mmu. */
+static bool vm_do_claim_page(struct page *page)
+{
+    struct frame *frame;
+    struct thread *curr = thread_current();
+    bool shared = vm_is_shared_file(page);
+    bool succ;
+
+    page->prefetch = PREFETCH_NONE;
+    if (shared && vm_share_file_frame(page, NULL, &succ))
+        return succ;
+    frame = vm_get_frame();
+    if (!frame)
+        return false;
+    /* Set links */
+    if (shared)
+    {
+        /* Somebody else read it in meanwhile. */
+        if (vm_share_file_frame(page, frame, &succ))
+        {
+            palloc_free_page(frame->kva);
+            free(frame);
+            return succ;
+        }
+    }
+    else
+    {
+        lock_acquire(&frame_lock);
+        frame_rmap_add(frame, page);
+        lock_release(&frame_lock);
+    }
+
+    /* TODO: Insert page table entry to map page's VA to frame's PA. */
+    succ = pml4_set_page(curr->pml4, page->va, frame->kva, page->writable) &&
+           swap_in(page, frame->kva);
+
+    lock_acquire(&frame_lock);
+    frame->loading = false;
+    evict_admit(frame);
+    frame_wake_waiters();
+    lock_release(&frame_lock);
+    return succ;
+}
+
+/* Initialize new supplemental page table */
+void supplemental_page_table_init(struct supplemental_page_table *spt UNUSED)
+{
+    hash_init(&spt->pages, page_hash, page_less, NULL);
+    spt->regions = NULL;
+    spt->snap = NULL;
+}
+
+/* Copy supplemental page table from src to dst */
+bool supplemental_page_table_copy(struct supplemental_page_table *dst UNUSED,
+                                  struct supplemental_page_table *src UNUSED)
+{
+    struct hash_iterator i;
+
+    /* Untouched parts of the regions need no copying at all, and
+     * anonymous pages are shared through a snapshot. What is left are
+     * file-backed pages and unloaded pages outside any region. */
+    if (!spt_copy_vmas(dst, src) || !spt_freeze(dst, src))
+        return false;
+
+    hash_first(&i, &src->pages);
+    while (hash_next(&i))
+    {
+        struct page *src_page = hash_entry(hash_cur(&i), struct page, hash_elem);
+        struct page *dst_page;
+        enum vm_type src_type = VM_TYPE(src_page->operations->type);
+
+        if (src_page->vma)
+        {
+            if (src_type == VM_UNINIT)
+                continue;
+            dst_page = vma_alloc_page(dst, spt_find_vma(dst, src_page->va),
+                                      src_page->va);
+        }
+        else if (src_type == VM_UNINIT)
+        {
+            if (!vm_alloc_page_with_initializer(
+                    src_page->uninit.type, src_page->va, src_page->writable,
+                    src_page->uninit.init, src_page->uninit.aux))
+            {
+                return false;
+            }
+            continue;
+        }
+        else
+        {
+            if (!vm_alloc_page(src_type, src_page->va, src_page->writable))
+            {
+                return false;
+            }
+            dst_page = spt_find_page(dst, src_page->va);
+        }
+
+        if (dst_page == NULL)
+        {
+            return false;
+        }
+        dst_page->operations = src_page->operations;
+        dst_page->original_writable = src_page->original_writable;
+        dst_page->slot_idx = BITMAP_ERROR;
+
+        lock_acquire(&frame_lock);
+        if (src_page->frame == NULL)
+        {
+            /* Swapped out: share the slot, or re-read the file later. */
+            if (src_type == VM_ANON)
+                swap_slot_dup(src_page->slot_idx);
+            dst_page->slot_idx = src_page->slot_idx;
+            dst_page->writable = src_page->writable;
+            lock_release(&frame_lock);
+            continue;
+        }
+        dst_page->writable = false;
+        src_page->writable = false;
+        if (src_page->frame == &zero_frame)
+            dst_page->frame = &zero_frame;
+        else
+            frame_rmap_add(src_page->frame, dst_page);
+        lock_release(&frame_lock);
+
+        if (!pml4_set_page(thread_current()->pml4, dst_page->va,
+                           dst_page->frame->kva, false))
+            return false;
+
+        if (!pml4_set_page(src_page->owner->pml4, src_page->va,
+                           src_page->frame->kva, false))
+            return false;
+    }
+    return true;
+}
+
+/* Free the resource hold by the supplemental page table */
+void supplemental_page_table_kill(struct supplemental_page_table *spt UNUSED)
+{
+    /* TODO: Destroy all the supplemental_page_table hold by thread and
+     * TODO: writeback all the modified contents to the storage. */
+    struct tlb_batch batch;
+
+    vm_prefetch_drain(thread_current());
+    spt_for_each_vma(spt, file_vma_writeback);
+    /* While the table still tells what this process had thawed. */
+    snapshot_put(spt->snap, &spt->pages);
+    spt->snap = NULL;
+    pml4_batch_begin(&batch, thread_current()->pml4);
+    hash_clear(&spt->pages, hash_destroy_support);
+    pml4_batch_end(&batch);
+    spt_destroy_vmas(spt);
+}
+
+/* Returns the page at VA in SNAP or the snapshots below it, the newest
+ * one first, and the snapshot it is in through *FOUND. Returns NULL if
+ * there is none. Must hold snapshot_lock. */
+static struct page *snapshot_find(struct spt_snapshot *snap, void *va,
+                                  struct spt_snapshot **found)
+{
+    struct page key;
+
+    key.va = va;
+    for (; snap != NULL; snap = snap->parent)
+    {
+        struct hash_elem *e = hash_find(&snap->pages, &key.hash_elem);
+
+        if (e)
+        {
+            *found = snap;
+            return hash_entry(e, struct page, hash_elem);
+        }
+    }
+    return NULL;
+}
+
+/* A stub stays in a snapshot in place of a page that all of its holders
+ * have thawed. It remembers that the snapshot, as a holder of the one
+ * below, has the page at its address already; see snapshot_put(). */
+static bool snapshot_is_stub(const struct page *p)
+{
+    return p->operations == NULL;
+}
+
+/* Moves the anonymous pages of SRC, the current process's parent, into
+ * a snapshot that SRC and DST both see. The parent's PTEs for them are
+ * cleared, so each side faults once before using a page again. */
+static bool spt_freeze(struct supplemental_page_table *dst,
+                       struct supplemental_page_table *src)
+{
+    struct spt_snapshot *snap, *found;
+    struct hash_iterator i;
+    struct list frozen;
+
+    lock_acquire(&snapshot_lock);
+    fork_cnt++;
+    lock_release(&snapshot_lock);
+
+    snap = malloc(sizeof *snap);
+    if (!snap || !hash_init(&snap->pages, page_hash, page_less, NULL))
+    {
+        free(snap);
+        return false;
+    }
+
+    /* Other pages of SRC that hide a frozen one leave a stub in the new
+     * snapshot: DST does not get a copy of every one of them, and SRC has
+     * thawed that frozen page already. */
+    lock_acquire(&snapshot_lock);
+    hash_first(&i, &src->pages);
+    while (hash_next(&i))
+    {
+        struct page *p = hash_entry(hash_cur(&i), struct page, hash_elem);
+        struct page *stub;
+
+        if (VM_TYPE(p->operations->type) == VM_ANON ||
+            !snapshot_find(src->snap, p->va, &found))
+            continue;
+        stub = calloc(1, sizeof *stub);
+        if (!stub)
+        {
+            lock_release(&snapshot_lock);
+            hash_destroy(&snap->pages, snapshot_destroy_page);
+            free(snap);
+            return false;
+        }
+        stub->va = p->va;
+        hash_insert(&snap->pages, &stub->hash_elem);
+    }
+    lock_release(&snapshot_lock);
+
+    /* Pick the pages first; the table cannot change while iterating. A
+     * frozen page leaves its region, so vma_elem is free to use. */
+    list_init(&frozen);
+    hash_first(&i, &src->pages);
+    while (hash_next(&i))
+    {
+        struct page *p = hash_entry(hash_cur(&i), struct page, hash_elem);
+
+        if (VM_TYPE(p->operations->type) != VM_ANON)
+            continue;
+        if (p->vma)
+            list_remove(&p->vma_elem);
+        list_push_back(&frozen, &p->vma_elem);
+    }
+
+    if (list_empty(&frozen) && hash_empty(&snap->pages))
+    {
+        /* Nothing new; share whatever is frozen already. SRC has thawed
+         * none of it, or it would have something to freeze, so DST joins
+         * the holders that every page waits for. */
+        hash_destroy(&snap->pages, NULL);
+        free(snap);
+        lock_acquire(&snapshot_lock);
+        if (src->snap)
+        {
+            src->snap->refs++;
+            hash_first(&i, &src->snap->pages);
+            while (hash_next(&i))
+                hash_entry(hash_cur(&i), struct page, hash_elem)
+                    ->frozen_refs++;
+        }
+        lock_release(&snapshot_lock);
+        dst->snap = src->snap;
+        return true;
+    }
+
+    while (!list_empty(&frozen))
+    {
+        struct page *p = list_entry(list_pop_front(&frozen), struct page,
+                                    vma_elem);
+        uint64_t *pml4 = p->owner->pml4;
+
+        hash_delete(&src->pages, &p->hash_elem);
+        vm_settle_around(p, pml4);
+        lock_acquire(&frame_lock);
+        pml4_clear_page(pml4, p->va);
+        p->owner = NULL;
+        p->vma = NULL;
+        p->writable = false;
+        lock_release(&frame_lock);
+        p->frozen_refs = 2;
+        hash_insert(&snap->pages, &p->hash_elem);
+        frozen_cnt++;
+    }
+
+    /* The parent's reference to its old snapshot moves to the new one,
+     * which has thawed what the parent had. */
+    lock_acquire(&snapshot_lock);
+    snap->refs = 2;
+    snap->parent = src->snap;
+    src->snap = dst->snap = snap;
+    lock_release(&snapshot_lock);
+    return true;
+}
+
+/* Frees the frame or swap slot of P, a page of SNAP that none of its
+ * holders can reach any more. P stays behind as a stub if there is an
+ * older snapshot below SNAP, and goes altogether if not. Must hold
+ * snapshot_lock. */
+static void snapshot_release_page(struct spt_snapshot *snap, struct page *p)
+{
+    evict_forget(p);
+    if (p->frame)
+        free_frame(p);
+    else
+        swap_slot_free(p->slot_idx);
+    if (snap->parent != NULL)
+        p->operations = NULL;
+    else
+    {
+        hash_delete(&snap->pages, &p->hash_elem);
+        free(p);
+    }
+}
+
+/* Hands P, a page of SNAP, to one of SNAP's holders that has not had it
+ * yet. This is P itself if it was the last holder to wait for P and P
+ * needs no stub, and a copy sharing its frame or swap slot otherwise.
+ * Returns NULL if out of memory. Must hold snapshot_lock. */
+static struct page *snapshot_take(struct spt_snapshot *snap, struct page *p)
+{
+    struct page *copy;
+
+    if (p->frozen_refs == 1 && snap->parent == NULL)
+    {
+        hash_delete(&snap->pages, &p->hash_elem);
+        thaw_take_cnt++;
+        return p;
+    }
+
+    copy = malloc(sizeof *copy);
+    if (!copy)
+        return NULL;
+    lock_acquire(&frame_lock);
+    *copy = *p;
+    copy->frame = NULL;
+    copy->ghost = false;
+    copy->prefetch = PREFETCH_NONE;
+    if (p->frame == &zero_frame)
+        copy->frame = &zero_frame;
+    else if (p->frame)
+        frame_rmap_add(p->frame, copy);
+    else
+        swap_slot_dup(p->slot_idx);
+    lock_release(&frame_lock);
+    thaw_copy_cnt++;
+
+    if (--p->frozen_refs == 0)
+        snapshot_release_page(snap, p);
+    return copy;
+}
+
+/* Takes the page at VA out of the snapshots under SPT, the current
+ * process's table, and maps it if it is resident. Returns NULL if no
+ * snapshot has a page at VA. A page found in an older snapshot is
+ * handed up through each newer one on the way, since each of those is
+ * a holder of the one below it. */
+static struct page *spt_thaw(struct supplemental_page_table *spt, void *va)
+{
+    struct thread *curr = thread_current();
+    struct spt_snapshot *snap;
+    struct page *page;
+
+    lock_acquire(&snapshot_lock);
+    page = snapshot_find(spt->snap, va, &snap);
+    if (!page || snapshot_is_stub(page))
+    {
+        lock_release(&snapshot_lock);
+        return NULL;
+    }
+    while (snap != spt->snap)
+    {
+        struct spt_snapshot *above = spt->snap;
+
+        while (above->parent != snap)
+            above = above->parent;
+        page = snapshot_take(snap, page);
+        if (!page)
+        {
+            lock_release(&snapshot_lock);
+            return NULL;
+        }
+        page->frozen_refs = above->refs;
+        hash_insert(&above->pages, &page->hash_elem);
+        snap = above;
+    }
+    page = snapshot_take(snap, page);
+    if (!page)
+    {
+        lock_release(&snapshot_lock);
+        return NULL;
+    }
+
+    lock_acquire(&frame_lock);
+    page->owner = curr;
+    if (page->frame == NULL)
+        /* Swapped out; it gets a frame of its own on swap-in. */
+        page->writable = page->original_writable;
+    else if (page->frame == &zero_frame)
+        pml4_set_page(curr->pml4, page->va, zero_frame.kva, false);
+    else if (!page->frame->evicting)
+    {
+        page->writable = page->original_writable &&
+                         page->frame->ref_count == 1;
+        pml4_set_page(curr->pml4, page->va, page->frame->kva,
+                      page->writable);
+    }
+    lock_release(&frame_lock);
+    lock_release(&snapshot_lock);
+
+    hash_insert(&spt->pages, &page->hash_elem);
+    return page;
+}
+
+/* Frees a page left in a dying snapshot. */
+static void snapshot_destroy_page(struct hash_elem *e, void *aux UNUSED)
+{
+    struct page *p = hash_entry(e, struct page, hash_elem);
+
+    if (!snapshot_is_stub(p))
+    {
+        evict_forget(p);
+        if (p->frame)
+            free_frame(p);
+        else
+            swap_slot_free(p->slot_idx);
+    }
+    free(p);
+}
+
+/* Tells the pages of SNAP that a holder whose own pages are SHADOW has
+ * gone, releasing those it was the last one to wait for. Pages at the
+ * addresses in SHADOW it had thawed already. Must hold snapshot_lock. */
+static void snapshot_forget(struct spt_snapshot *snap, struct hash *shadow)
+{
+    struct hash_iterator i;
+    struct list gone;
+
+    /* A frozen page has no region, so vma_elem is free to use. */
+    list_init(&gone);
+    hash_first(&i, &snap->pages);
+    while (hash_next(&i))
+    {
+        struct page *p = hash_entry(hash_cur(&i), struct page, hash_elem);
+
+        if (!snapshot_is_stub(p) && !hash_find(shadow, &p->hash_elem) &&
+            --p->frozen_refs == 0)
+            list_push_back(&gone, &p->vma_elem);
+    }
+    while (!list_empty(&gone))
+        snapshot_release_page(snap, list_entry(list_pop_front(&gone),
+                                               struct page, vma_elem));
+}
+
+/* Drops a reference to SNAP held by a page table or snapshot whose own
+ * pages are SHADOW, freeing SNAP and the snapshots below it that nobody
+ * can see any more. */
+static void snapshot_put(struct spt_snapshot *snap, struct hash *shadow)
+{
+    struct spt_snapshot *dead = NULL;
+
+    lock_acquire(&snapshot_lock);
+    while (snap != NULL)
+    {
+        struct spt_snapshot *parent = snap->parent;
+        bool last = --snap->refs == 0;
+
+        if (!last)
+            snapshot_forget(snap, shadow);
+        if (dead != NULL)
+        {
+            hash_destroy(&dead->pages, snapshot_destroy_page);
+            free(dead);
+            dead = NULL;
+        }
+        if (!last)
+            break;
+        /* Now a holder of PARENT that is going away. */
+        dead = snap;
+        shadow = &snap->pages;
+        snap = parent;
+    }
+    if (dead != NULL)
+    {
+        hash_destroy(&dead->pages, snapshot_destroy_page);
+        free(dead);
+    }
+    lock_release(&snapshot_lock);
+}
+
+static void hash_destroy_support(struct hash_elem *e, void *aux)
+{
+    struct page *p = hash_entry(e, struct page, hash_elem);
+
+    if (p->vma)
+        list_remove(&p->vma_elem);
+    vm_settle_around(p, thread_current()->pml4);
+    evict_forget(p);
+    vm_dealloc_page(p);
+}
 
 unsigned page_hash(const struct hash_elem *p_, void *aux UNUSED)
 {
@@ -409,32 +1706,338 @@ bool page_less(const struct hash_elem *a_, const struct hash_elem *b_,
     return a->va < b->va;
 }
 
-static void write_contents(struct page *page)
+/* Drops PAGE's mapping of its frame. The frame itself is freed once its
+ * last mapper is gone, unless an evictor currently owns it. */
+void free_frame(struct page *page)
 {
-    struct load_info *info = (struct load_info *)page->uninit.aux;
-    file_seek(info->file, info->offset);
-    file_write(info->file, page->frame->kva, info->page_read_bytes);
+    struct frame *frame = page->frame;
 
-    if (page->is_last_file_page)
+    if (frame == &zero_frame)
     {
-        file_close(info->file);
+        page->frame = NULL;
+        return;
     }
-}
 
-void free_frame(struct frame *frame)
-{
     lock_acquire(&frame_lock);
+    frame_rmap_remove(frame, page);
+    page->frame = NULL;
 
-    if (frame->ref_count > 1)
+    if (frame->ref_count > 0 || frame->evicting)
     {
-        frame->ref_count--;
         lock_release(&frame_lock);
         return;
     }
 
-    list_remove(&frame->elem);
+    evict_remove(frame);
+    file_index_remove(frame);
     palloc_free_page(frame->kva);
     free(frame);
 
     lock_release(&frame_lock);
 }
+
+/* Wakes the threads waiting for a frame to stop being evicted or loaded.
+ * Must hold frame_lock. */
+void frame_wake_waiters(void)
+{
+    cond_broadcast(&frame_settled, &frame_lock);
+}
+
+/* Clears the PTE of every page that maps FRAME, so that no process can
+ * touch it any longer. Returns true if any of them had dirtied it.
+ * FRAME must be owned by the caller through vm_get_victim(). */
+bool frame_unmap_all(struct frame *frame)
+{
+    struct list_elem *e;
+    bool dirty = false;
+
+    lock_acquire(&frame_lock);
+    for (e = list_begin(&frame->rmap); e != list_end(&frame->rmap);
+         e = list_next(e))
+    {
+        struct page *p = list_entry(e, struct page, rmap_elem);
+        uint64_t *pml4 = p->owner ? p->owner->pml4 : NULL;
+
+        if (pml4 == NULL)
+            continue;
+        vm_settle_around(p, pml4);
+        dirty |= pml4_is_dirty(pml4, p->va);
+        pml4_clear_page(pml4, p->va);
+    }
+    lock_release(&frame_lock);
+    return dirty;
+}
+
+/* Records that PAGE maps FRAME. Must hold frame_lock. */
+static void frame_rmap_add(struct frame *frame, struct page *page)
+{
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+
+    list_push_back(&frame->rmap, &page->rmap_elem);
+    frame->ref_count++;
+    if (frame->page == NULL)
+        frame->page = page;
+    page->frame = frame;
+}
+
+/* Forgets that PAGE maps FRAME. Must hold frame_lock. */
+static void frame_rmap_remove(struct frame *frame, struct page *page)
+{
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+
+    list_remove(&page->rmap_elem);
+    frame->ref_count--;
+    if (frame->page == page)
+        frame->page = list_empty(&frame->rmap)
+                          ? NULL
+                          : list_entry(list_front(&frame->rmap), struct page,
+                                       rmap_elem);
+}
+
+/* Tests and clears the accessed bit of FRAME in every address space that
+ * maps it. A frame is only cold if nobody touched it. Must hold
+ * frame_lock. */
+bool frame_test_and_clear_accessed(struct frame *frame)
+{
+    struct list_elem *e;
+    bool accessed = false;
+
+    for (e = list_begin(&frame->rmap); e != list_end(&frame->rmap);
+         e = list_next(e))
+    {
+        struct page *p = list_entry(e, struct page, rmap_elem);
+        uint64_t *pml4 = p->owner ? p->owner->pml4 : NULL;
+
+        if (pml4 != NULL && (p->young || pml4_is_accessed(pml4, p->va)))
+        {
+            p->young = false;
+            vm_settle_around(p, pml4);
+            pml4_set_accessed(pml4, p->va, 0);
+            accessed = true;
+        }
+    }
+    return accessed;
+}
+
+/* Counts page P, which the current process can see, into ST. FROZEN
+ * pages sit in a snapshot and are shared with other processes. */
+static void mstat_count(struct mstat *st, struct page *p, bool frozen)
+{
+    if (p->frame == &zero_frame)
+        return;
+    if (p->frame != NULL)
+    {
+        st->rss++;
+        if (frozen || p->frame->ref_count > 1)
+            st->shared++;
+    }
+    else if (p->operations->type == VM_ANON && p->slot_idx != BITMAP_ERROR)
+        st->swapped++;
+}
+
+/* Returns true if VA in snapshot UPTO of SPT is hidden by the page table
+ * itself or by a newer snapshot. */
+static bool mstat_shadowed(struct supplemental_page_table *spt,
+                           struct spt_snapshot *upto, void *va)
+{
+    struct spt_snapshot *snap;
+    struct page key;
+
+    key.va = va;
+    if (hash_find(&spt->pages, &key.hash_elem))
+        return true;
+    for (snap = spt->snap; snap != upto; snap = snap->parent)
+        if (hash_find(&snap->pages, &key.hash_elem))
+            return true;
+    return false;
+}
+
+/* Fills ST with the memory use of the current process. Pages still
+ * frozen in a snapshot count as shared. */
+void vm_mstat(struct mstat *st)
+{
+    struct thread *curr = thread_current();
+    struct supplemental_page_table *spt = &curr->spt;
+    struct spt_snapshot *snap;
+    struct hash_iterator i;
+
+    memset(st, 0, sizeof *st);
+    lock_acquire(&snapshot_lock);
+    lock_acquire(&frame_lock);
+    hash_first(&i, &spt->pages);
+    while (hash_next(&i))
+        mstat_count(st, hash_entry(hash_cur(&i), struct page, hash_elem),
+                    false);
+    for (snap = spt->snap; snap != NULL; snap = snap->parent)
+    {
+        hash_first(&i, &snap->pages);
+        while (hash_next(&i))
+        {
+            struct page *p = hash_entry(hash_cur(&i), struct page, hash_elem);
+
+            if (!snapshot_is_stub(p) && !mstat_shadowed(spt, snap, p->va))
+                mstat_count(st, p, true);
+        }
+    }
+    lock_release(&frame_lock);
+    lock_release(&snapshot_lock);
+
+    st->wss = curr->wss;
+    st->peak_rss = curr->peak_rss > st->rss ? curr->peak_rss : st->rss;
+    st->peak_wss = curr->peak_wss;
+}
+
+/* Estimates the working set of the current process, at most once every
+ * WS_INTERVAL ticks: the pages of its supplemental page table whose
+ * accessed bit is set are the ones it used since the last sample. The
+ * bits are cleared for the next one, and page->young keeps the reference
+ * for the replacement policy. Called when the process holds no VM locks:
+ * on the way into the kernel by a system call or user page fault, and
+ * on the way back to user mode from a timer interrupt, so that a
+ * process that only computes is sampled too. */
+void vm_sample_ws(void)
+{
+    struct thread *curr = thread_current();
+    uint64_t *pml4 = curr->pml4;
+    int64_t now = timer_ticks();
+    struct hash_iterator i;
+    struct mstat st;
+    size_t wss = 0;
+
+    if (pml4 == NULL || now < curr->ws_next)
+        return;
+    curr->ws_next = now + WS_INTERVAL;
+
+    lock_acquire(&frame_lock);
+    /* Count first, then clear: a 2 MB mapping has a single accessed bit
+     * for all of its pages, which are all in the SPT. */
+    hash_first(&i, &curr->spt.pages);
+    while (hash_next(&i))
+    {
+        struct page *p = hash_entry(hash_cur(&i), struct page, hash_elem);
+
+        if (p->frame != NULL && p->frame != &zero_frame &&
+            pml4_is_accessed(pml4, p->va))
+        {
+            p->young = true;
+            wss++;
+        }
+    }
+    hash_first(&i, &curr->spt.pages);
+    while (hash_next(&i))
+    {
+        struct page *p = hash_entry(hash_cur(&i), struct page, hash_elem);
+
+        if (p->young && pml4_is_accessed(pml4, p->va))
+        {
+            vm_settle_around(p, pml4);
+            /* Every page of the block counted, and took, the bit. */
+            if (pml4_is_huge(pml4, p->va))
+                pml4_clear_huge_accessed(pml4, p->va);
+            else
+                pml4_set_accessed(pml4, p->va, false);
+        }
+    }
+    lock_release(&frame_lock);
+
+    curr->wss = wss;
+    if (wss > curr->peak_wss)
+        curr->peak_wss = wss;
+    vm_mstat(&st);
+    curr->peak_rss = st.peak_rss;
+}
+
+/* Records the memory use of the current process, which is exiting, for
+ * vm_print_stats(). */
+void vm_mstat_record(void)
+{
+    struct thread *curr = thread_current();
+    struct mstat_record *r = &mstat_log[mstat_log_cnt++ % MSTAT_LOG_SIZE];
+
+    vm_mstat(&r->st);
+    memcpy(r->faults, curr->fault_cnt, sizeof r->faults);
+    strlcpy(r->name, curr->name, sizeof r->name);
+    r->tid = curr->tid;
+}
+
+/* Prints the memory use of the last processes to exit. */
+static void mstat_print_log(void)
+{
+    size_t first = mstat_log_cnt > MSTAT_LOG_SIZE
+                       ? mstat_log_cnt - MSTAT_LOG_SIZE
+                       : 0;
+
+    for (size_t n = first; n < mstat_log_cnt; n++)
+    {
+        struct mstat_record *r = &mstat_log[n % MSTAT_LOG_SIZE];
+
+        printf("Process %s (%d): RSS %zu (peak %zu), %zu shared, "
+               "%zu swapped, WSS %zu (peak %zu)\n",
+               r->name, r->tid, r->st.rss, r->st.peak_rss, r->st.shared,
+               r->st.swapped, r->st.wss, r->st.peak_wss);
+        printf("  faults:");
+        for (int c = 0; c < FAULT_CLASS_CNT; c++)
+            printf(" %s %"PRIu64, fault_class_names[c], r->faults[c]);
+        printf("\n");
+    }
+}
+
+/* Copies the fault latency histograms, and the fault counts of the
+ * current process, to FS. FS may be user memory that faults, so the
+ * copy is not atomic with respect to other faults. */
+void vm_faultstat(struct faultstat *fs)
+{
+    memcpy(fs, &fault_stats, sizeof *fs);
+    memcpy(fs->proc_count, thread_current()->fault_cnt,
+           sizeof fs->proc_count);
+}
+
+/* Prints the fault latency histogram of every class that had faults. */
+static void fault_print_stats(void)
+{
+    for (int c = 0; c < FAULT_CLASS_CNT; c++)
+    {
+        uint64_t cnt = fault_stats.count[c];
+
+        if (cnt == 0)
+            continue;
+        printf("Fault latency %s: %"PRIu64" faults, mean %"PRIu64" cycles;",
+               fault_class_names[c], cnt, fault_stats.cycles[c] / cnt);
+        for (int b = 0; b < FAULT_HIST_BUCKETS; b++)
+            if (fault_stats.hist[c][b] != 0)
+                printf(" %s2^%d %"PRIu64, b < FAULT_HIST_BUCKETS - 1 ? "<" : ">=",
+                       b < FAULT_HIST_BUCKETS - 1 ? 10 + b : 9 + b,
+                       fault_stats.hist[c][b]);
+        printf("\n");
+    }
+}
+
+/* Prints statistics about the VM subsystem. */
+void vm_print_stats(void)
+{
+    evict_print_stats();
+    anon_print_stats();
+    zswap_print_stats();
+    kswapd_print_stats();
+    printf("Zero page: %lld read faults mapped, %lld copied on write\n",
+           zero_map_cnt, zero_cow_cnt);
+    printf("Fault-around: %lld pages mapped, %lld faults saved\n",
+           around_mapped_cnt, around_saved_cnt);
+    printf("Huge pages: %lld mapped, %"PRIu64" split\n", huge_map_cnt,
+           pml4_huge_splits);
+    printf("TLB: PCIDs %s, %"PRIu64" switches kept entries, %"PRIu64
+           " flushed, %"PRIu64" batch flushes saved %"PRIu64" INVLPGs\n",
+           pml4_use_pcid ? "on" : "off", pml4_switches_kept,
+           pml4_switches_flushed, pml4_batch_flushes, pml4_batch_saved);
+    printf("Fork: %lld forks, %lld pages frozen, %lld copied on touch, "
+           "%lld taken back\n",
+           fork_cnt, frozen_cnt, thaw_copy_cnt, thaw_take_cnt);
+    file_print_stats();
+    printf("Madvise: %lld pages prefetched, %lld used, %lld dropped\n",
+           prefetch_cnt, prefetch_hit_cnt, dontneed_cnt);
+    printf("Stack: %lld growths, %lld pages added, %lld mapped ahead, "
+           "%lld faults past the limit\n",
+           stack_grow_cnt, stack_page_cnt, stack_claim_cnt, stack_kill_cnt);
+    fault_print_stats();
+    mstat_print_log();
+}
@@ -0,0 +1,294 @@
+/* vma.c: Virtual memory areas.
+ * Each process keeps its regions in an AVL tree ordered by start address,
+ * so that the region of a faulting address is found in O(log n) and a
+ * mapping is set up and torn down without touching its pages one by
+ * one. */
+
+#include "vm/vma.h"
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/vaddr.h"
+#include <madvise.h>
+#include <round.h>
+
+static int tree_height(const struct vma *n);
+static struct vma *tree_insert(struct vma *root, struct vma *vma);
+static struct vma *tree_remove(struct vma *root, struct vma *vma);
+static void tree_destroy(struct vma *root);
+static void tree_for_each(struct vma *n, void (*func)(struct vma *));
+static bool tree_copy(struct supplemental_page_table *dst,
+                      const struct vma *n);
+
+/* Creates a region of LENGTH bytes, rounded up to whole pages, at START.
+ * The region takes over FILE, which it closes when destroyed. Returns
+ * NULL if memory is exhausted. */
+struct vma *vma_create(void *start, size_t length, enum vm_type type,
+                       bool writable, struct file *file, off_t offset,
+                       size_t read_bytes, vm_initializer *init)
+{
+    struct vma *vma = malloc(sizeof *vma);
+
+    ASSERT(pg_ofs(start) == 0);
+    if (vma == NULL)
+        return NULL;
+    vma->start = start;
+    vma->end = start + ROUND_UP(length, PGSIZE);
+    vma->type = type;
+    vma->writable = writable;
+    vma->file = file;
+    vma->offset = offset;
+    vma->read_bytes = read_bytes;
+    vma->init = init;
+    list_init(&vma->pages);
+    vma->advice = MADV_NORMAL;
+    vma->seq_mark = start;
+    vma->left = vma->right = NULL;
+    vma->height = 1;
+    return vma;
+}
+
+/* Frees VMA, which must not be in a tree and must have no pages left. */
+void vma_destroy(struct vma *vma)
+{
+    ASSERT(list_empty(&vma->pages));
+    if (vma->file != NULL)
+        file_close(vma->file);
+    free(vma);
+}
+
+/* Returns the file offset of the page at VA in VMA. */
+off_t vma_page_offset(const struct vma *vma, const void *va)
+{
+    return vma->offset + (pg_round_down(va) - vma->start);
+}
+
+/* Returns the number of bytes of the page at VA in VMA that come from
+ * the file; the rest of the page is zero. */
+size_t vma_page_read_bytes(const struct vma *vma, const void *va)
+{
+    size_t ofs = pg_round_down(va) - vma->start;
+
+    if (ofs >= vma->read_bytes)
+        return 0;
+    return vma->read_bytes - ofs < PGSIZE ? vma->read_bytes - ofs : PGSIZE;
+}
+
+/* Adds VMA to SPT. Returns false, leaving SPT unchanged, if VMA overlaps
+ * one of its regions. */
+bool spt_insert_vma(struct supplemental_page_table *spt, struct vma *vma)
+{
+    if (spt_overlaps_vma(spt, vma->start, vma->end))
+        return false;
+    spt->regions = tree_insert(spt->regions, vma);
+    return true;
+}
+
+/* Removes VMA from SPT without freeing it. */
+void spt_remove_vma(struct supplemental_page_table *spt, struct vma *vma)
+{
+    spt->regions = tree_remove(spt->regions, vma);
+}
+
+/* Returns the region of SPT that contains VA, or NULL. */
+struct vma *spt_find_vma(struct supplemental_page_table *spt, const void *va)
+{
+    struct vma *n = spt->regions;
+
+    while (n != NULL)
+    {
+        if (va < n->start)
+            n = n->left;
+        else if (va >= n->end)
+            n = n->right;
+        else
+            return n;
+    }
+    return NULL;
+}
+
+/* Returns true if any region of SPT overlaps [START, END). Regions never
+ * overlap each other, so they are ordered by their ends as well as by
+ * their starts. */
+bool spt_overlaps_vma(struct supplemental_page_table *spt, const void *start,
+                      const void *end)
+{
+    struct vma *n = spt->regions;
+
+    while (n != NULL)
+    {
+        if (end <= n->start)
+            n = n->left;
+        else if (start >= n->end)
+            n = n->right;
+        else
+            return true;
+    }
+    return false;
+}
+
+/* Copies the regions of SRC into DST, which has none, for fork. File
+ * backed regions get their own reopened file. Regions copied before a
+ * failure stay in DST and go away with it. */
+bool spt_copy_vmas(struct supplemental_page_table *dst,
+                   struct supplemental_page_table *src)
+{
+    ASSERT(dst->regions == NULL);
+    return tree_copy(dst, src->regions);
+}
+
+/* Calls FUNC on every region of SPT, in address order. */
+void spt_for_each_vma(struct supplemental_page_table *spt,
+                      void (*func)(struct vma *))
+{
+    tree_for_each(spt->regions, func);
+}
+
+/* Frees every region of SPT, whose pages must be gone already. */
+void spt_destroy_vmas(struct supplemental_page_table *spt)
+{
+    tree_destroy(spt->regions);
+    spt->regions = NULL;
+}
+
+static int tree_height(const struct vma *n)
+{
+    return n != NULL ? n->height : 0;
+}
+
+static void tree_update(struct vma *n)
+{
+    int l = tree_height(n->left), r = tree_height(n->right);
+    n->height = (l > r ? l : r) + 1;
+}
+
+static struct vma *tree_rotate_right(struct vma *n)
+{
+    struct vma *l = n->left;
+
+    n->left = l->right;
+    l->right = n;
+    tree_update(n);
+    tree_update(l);
+    return l;
+}
+
+static struct vma *tree_rotate_left(struct vma *n)
+{
+    struct vma *r = n->right;
+
+    n->right = r->left;
+    r->left = n;
+    tree_update(n);
+    tree_update(r);
+    return r;
+}
+
+/* Restores the AVL invariant at N, whose subtrees are balanced and differ
+ * in height by at most two. Returns the new root of the subtree. */
+static struct vma *tree_rebalance(struct vma *n)
+{
+    int balance = tree_height(n->left) - tree_height(n->right);
+
+    tree_update(n);
+    if (balance > 1)
+    {
+        if (tree_height(n->left->left) < tree_height(n->left->right))
+            n->left = tree_rotate_left(n->left);
+        return tree_rotate_right(n);
+    }
+    if (balance < -1)
+    {
+        if (tree_height(n->right->right) < tree_height(n->right->left))
+            n->right = tree_rotate_right(n->right);
+        return tree_rotate_left(n);
+    }
+    return n;
+}
+
+static struct vma *tree_insert(struct vma *root, struct vma *vma)
+{
+    if (root == NULL)
+    {
+        vma->left = vma->right = NULL;
+        vma->height = 1;
+        return vma;
+    }
+    if (vma->start < root->start)
+        root->left = tree_insert(root->left, vma);
+    else
+        root->right = tree_insert(root->right, vma);
+    return tree_rebalance(root);
+}
+
+/* Unlinks the lowest region under N into *MIN. */
+static struct vma *tree_remove_min(struct vma *n, struct vma **min)
+{
+    if (n->left == NULL)
+    {
+        *min = n;
+        return n->right;
+    }
+    n->left = tree_remove_min(n->left, min);
+    return tree_rebalance(n);
+}
+
+static struct vma *tree_remove(struct vma *root, struct vma *vma)
+{
+    ASSERT(root != NULL);
+    if (root == vma)
+    {
+        struct vma *succ, *right;
+
+        if (root->right == NULL)
+            return root->left;
+        right = tree_remove_min(root->right, &succ);
+        succ->left = root->left;
+        succ->right = right;
+        return tree_rebalance(succ);
+    }
+    if (vma->start < root->start)
+        root->left = tree_remove(root->left, vma);
+    else
+        root->right = tree_remove(root->right, vma);
+    return tree_rebalance(root);
+}
+
+static void tree_destroy(struct vma *root)
+{
+    if (root == NULL)
+        return;
+    tree_destroy(root->left);
+    tree_destroy(root->right);
+    vma_destroy(root);
+}
+
+static bool tree_copy(struct supplemental_page_table *dst,
+                      const struct vma *n)
+{
+    struct vma *vma;
+    struct file *file = NULL;
+
+    if (n == NULL)
+        return true;
+    if (n->file != NULL && (file = file_reopen(n->file)) == NULL)
+        return false;
+    vma = vma_create(n->start, n->end - n->start, n->type, n->writable,
+                     file, n->offset, n->read_bytes, n->init);
+    if (vma == NULL)
+    {
+        file_close(file);
+        return false;
+    }
+    vma->advice = n->advice;
+    dst->regions = tree_insert(dst->regions, vma);
+    return tree_copy(dst, n->left) && tree_copy(dst, n->right);
+}
+
+static void tree_for_each(struct vma *n, void (*func)(struct vma *))
+{
+    if (n == NULL)
+        return;
+    tree_for_each(n->left, func);
+    func(n);
+    tree_for_each(n->right, func);
+}
@@ -0,0 +1,435 @@
+/* zswap.c: Compressed in-memory swap pool.
+ * Anonymous pages on their way to the swap disk are compressed into a
+ * bounded pool of kernel pages instead, and only written to the disk when
+ * the pool overflows, oldest first. A stored page keeps the swap slot it
+ * was given, so slot reference counting, sharing and freeing work the
+ * same whether a slot's contents live here or on the disk.
+ *
+ * Pool pages are shared "zbud" style: each holds at most two compressed
+ * pages, one packed against its start and one against its end. Pages
+ * that repeat a single word, mostly zeros, take no pool space at all.
+ * Everything here runs with swap_lock held. */
+
+#include "vm/zswap.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include <debug.h>
+#include <list.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+size_t zswap_max_pages = 128;
+
+/* Pages that do not compress below this size go straight to disk. */
+#define ZSWAP_MAX_LEN (PGSIZE * 3 / 4)
+
+/* A pool page. */
+struct zpage
+{
+    uint8_t *kva;              /* Kernel page holding the data. */
+    struct zentry *buddy[2];   /* At the start and at the end of it. */
+    struct list_elem elem;     /* In zpages. */
+};
+
+/* A compressed page. */
+struct zentry
+{
+    size_t slot_idx;           /* Swap slot it stands for. */
+    struct zpage *zp;          /* Pool page holding it, or NULL. */
+    int side;                  /* Index in zp->buddy. */
+    size_t len;                /* Compressed length. */
+    uint64_t fill;             /* Repeated word, if zp is NULL. */
+    struct list_elem lru_elem; /* In lru, oldest first. */
+};
+
+static struct zentry **slot_zentry;    /* Entry of each swap slot. */
+static struct list zpages;             /* All pool pages. */
+static struct list lru;                /* All entries, oldest first. */
+static size_t zpage_cnt;               /* Pool pages in use. */
+static zswap_writeback_func *writeback;
+static uint8_t *scratch;               /* Compression output. */
+static uint8_t *bounce;                /* Decompressed victims. */
+
+/* Statistics. */
+static long long store_cnt;     /* # of pages stored. */
+static long long reject_cnt;    /* # of pages that did not compress. */
+static long long same_cnt;      /* # of those made of one repeated word. */
+static long long load_cnt;      /* # of swap-ins served from the pool. */
+static long long writeback_cnt; /* # of pages pushed out to disk. */
+static long long stored_bytes;  /* Compressed bytes currently held. */
+
+static size_t lz_compress(const uint8_t *src, size_t n, uint8_t *dst,
+                          size_t dst_max);
+static size_t lz_decompress(const uint8_t *src, size_t n, uint8_t *dst,
+                            size_t dst_max);
+
+/* Sets up the pool for SLOT_CNT swap slots. WRITEBACK is called to move
+ * the oldest pages to the disk when the pool is full. */
+void zswap_init(size_t slot_cnt, zswap_writeback_func *writeback_)
+{
+    list_init(&zpages);
+    list_init(&lru);
+    writeback = writeback_;
+    if (zswap_max_pages == 0)
+        return;
+    slot_zentry = calloc(slot_cnt, sizeof *slot_zentry);
+    scratch = palloc_get_page(0);
+    bounce = palloc_get_page(0);
+    if (slot_zentry == NULL || scratch == NULL || bounce == NULL)
+        zswap_max_pages = 0;
+}
+
+/* Returns the address of entry E's data. */
+static uint8_t *zentry_data(struct zentry *e)
+{
+    return e->side == 0 ? e->zp->kva : e->zp->kva + PGSIZE - e->len;
+}
+
+/* Returns true if KVA repeats one word, which is stored in *FILL. */
+static bool page_same_filled(const void *kva, uint64_t *fill)
+{
+    const uint64_t *w = kva;
+
+    for (size_t i = 1; i < PGSIZE / sizeof *w; i++)
+        if (w[i] != w[0])
+            return false;
+    *fill = w[0];
+    return true;
+}
+
+/* Writes entry E's page into KVA. */
+static void zentry_load(struct zentry *e, void *kva)
+{
+    uint64_t *w = kva;
+    size_t n;
+
+    if (e->zp == NULL)
+    {
+        for (size_t i = 0; i < PGSIZE / sizeof *w; i++)
+            w[i] = e->fill;
+        return;
+    }
+    n = lz_decompress(zentry_data(e), e->len, kva, PGSIZE);
+    ASSERT(n == PGSIZE);
+}
+
+/* Frees entry E and, once both of its buddies are gone, its pool page. */
+static void zentry_free(struct zentry *e)
+{
+    struct zpage *zp = e->zp;
+
+    if (zp != NULL)
+        zp->buddy[e->side] = NULL;
+    if (zp != NULL && zp->buddy[!e->side] == NULL)
+    {
+        list_remove(&zp->elem);
+        palloc_free_page(zp->kva);
+        free(zp);
+        zpage_cnt--;
+    }
+    list_remove(&e->lru_elem);
+    slot_zentry[e->slot_idx] = NULL;
+    stored_bytes -= e->len;
+    free(e);
+}
+
+/* Moves the oldest entry that takes pool space to the disk. Returns
+ * false if there is none. */
+static bool zswap_evict_oldest(void)
+{
+    struct list_elem *el;
+
+    for (el = list_begin(&lru); el != list_end(&lru); el = list_next(el))
+    {
+        struct zentry *e = list_entry(el, struct zentry, lru_elem);
+
+        if (e->zp == NULL)
+            continue;
+        zentry_load(e, bounce);
+        writeback(e->slot_idx, bounce);
+        writeback_cnt++;
+        zentry_free(e);
+        return true;
+    }
+    return false;
+}
+
+/* Finds room for LEN bytes next to a lone buddy, or in a new pool page
+ * while the pool may grow. Sets *SIDE to the free side. */
+static struct zpage *zpool_find(size_t len, int *side)
+{
+    struct list_elem *el;
+    struct zpage *zp;
+
+    for (el = list_begin(&zpages); el != list_end(&zpages);
+         el = list_next(el))
+    {
+        zp = list_entry(el, struct zpage, elem);
+        for (int s = 0; s < 2; s++)
+            if (zp->buddy[s] == NULL && zp->buddy[!s] != NULL &&
+                zp->buddy[!s]->len + len <= PGSIZE)
+            {
+                *side = s;
+                return zp;
+            }
+    }
+
+    if (zpage_cnt >= zswap_max_pages)
+        return NULL;
+    zp = calloc(1, sizeof *zp);
+    if (zp == NULL)
+        return NULL;
+    zp->kva = palloc_get_page(0);
+    if (zp->kva == NULL)
+    {
+        free(zp);
+        return NULL;
+    }
+    list_push_back(&zpages, &zp->elem);
+    zpage_cnt++;
+    *side = 0;
+    return zp;
+}
+
+/* Compresses KVA, the contents of swap slot SLOT_IDX, into the pool,
+ * pushing the oldest pages out to the disk if it is full. Returns false
+ * if the pool is disabled or the page does not compress well; the caller
+ * then writes it to the disk itself. */
+bool zswap_store(size_t slot_idx, const void *kva)
+{
+    struct zentry *e;
+    struct zpage *zp = NULL;
+    size_t len = 0;
+    uint64_t fill = 0;
+    int side = 0;
+
+    if (zswap_max_pages == 0)
+        return false;
+    ASSERT(slot_zentry[slot_idx] == NULL);
+    if (!page_same_filled(kva, &fill))
+    {
+        len = lz_compress(kva, PGSIZE, scratch, ZSWAP_MAX_LEN);
+        if (len == 0)
+        {
+            reject_cnt++;
+            return false;
+        }
+    }
+    e = malloc(sizeof *e);
+    if (e == NULL)
+        return false;
+    while (len > 0 && (zp = zpool_find(len, &side)) == NULL)
+        if (!zswap_evict_oldest())
+        {
+            free(e);
+            return false;
+        }
+
+    e->slot_idx = slot_idx;
+    e->zp = zp;
+    e->side = side;
+    e->len = len;
+    e->fill = fill;
+    if (zp != NULL)
+    {
+        zp->buddy[side] = e;
+        memcpy(zentry_data(e), scratch, len);
+    }
+    else
+        same_cnt++;
+    list_push_back(&lru, &e->lru_elem);
+    slot_zentry[slot_idx] = e;
+    stored_bytes += len;
+    store_cnt++;
+    return true;
+}
+
+/* Decompresses swap slot SLOT_IDX into KVA if the pool holds it. The
+ * entry stays until the slot is freed. */
+bool zswap_load(size_t slot_idx, void *kva)
+{
+    if (!zswap_contains(slot_idx))
+        return false;
+    zentry_load(slot_zentry[slot_idx], kva);
+    load_cnt++;
+    return true;
+}
+
+/* Returns true if the pool holds swap slot SLOT_IDX, whose disk copy is
+ * then stale. */
+bool zswap_contains(size_t slot_idx)
+{
+    return slot_zentry != NULL && slot_zentry[slot_idx] != NULL;
+}
+
+/* Forgets swap slot SLOT_IDX, which has been freed. */
+void zswap_invalidate(size_t slot_idx)
+{
+    if (zswap_contains(slot_idx))
+        zentry_free(slot_zentry[slot_idx]);
+}
+
+/* Prints statistics about the pool. */
+void zswap_print_stats(void)
+{
+    printf("Zswap: %lld pages stored (%lld same-filled), %lld rejected, "
+           "%lld loaded, %lld written back, %zu pool pages holding %lld "
+           "bytes\n",
+           store_cnt, same_cnt, reject_cnt, load_cnt, writeback_cnt,
+           zpage_cnt, stored_bytes);
+}
+
+/* LZ77 compression in the style of LZ4.
+ * The output is a series of sequences, each a token byte whose high
+ * nibble is the number of literals and whose low nibble is the match
+ * length minus LZ_MIN_MATCH, then the literals, then the match as a
+ * 16-bit little-endian distance back into the output. A nibble of 15 is
+ * continued by bytes that are added to it, up to and including the first
+ * one below 255. The last sequence has literals only. */
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 10
+
+/* Last position + 1 of each hashed 4-byte string, 0 for none. */
+static uint16_t lz_table[1 << LZ_HASH_BITS];
+
+static uint32_t lz_read32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof v);
+    return v;
+}
+
+static unsigned lz_hash(uint32_t v)
+{
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/* Writes the continuation bytes of a nibble that overflowed by N. */
+static uint8_t *lz_put_len(uint8_t *op, size_t n)
+{
+    for (; n >= 255; n -= 255)
+        *op++ = 255;
+    *op++ = n;
+    return op;
+}
+
+/* Writes a sequence of LIT literals and a match of MLEN bytes at
+ * distance DIST, or no match if MLEN is 0. Returns NULL if it does not
+ * fit before OEND. */
+static uint8_t *lz_put_seq(uint8_t *op, uint8_t *oend, const uint8_t *lit,
+                           size_t lit_len, size_t dist, size_t mlen)
+{
+    size_t need = 1 + lit_len / 255 + 1 + lit_len + 2 + mlen / 255 + 1;
+    size_t mcode = mlen ? mlen - LZ_MIN_MATCH : 0;
+
+    if ((size_t)(oend - op) < need)
+        return NULL;
+    *op++ = (lit_len < 15 ? lit_len : 15) << 4 | (mcode < 15 ? mcode : 15);
+    if (lit_len >= 15)
+        op = lz_put_len(op, lit_len - 15);
+    memcpy(op, lit, lit_len);
+    op += lit_len;
+    if (mlen == 0)
+        return op;
+    *op++ = dist & 0xff;
+    *op++ = dist >> 8;
+    if (mcode >= 15)
+        op = lz_put_len(op, mcode - 15);
+    return op;
+}
+
+/* Compresses the N bytes at SRC into DST. Returns the compressed length,
+ * or 0 if it would exceed DST_MAX. */
+static size_t lz_compress(const uint8_t *src, size_t n, uint8_t *dst,
+                          size_t dst_max)
+{
+    uint8_t *op = dst, *oend = dst + dst_max;
+    size_t ip = 0, anchor = 0;
+
+    memset(lz_table, 0, sizeof lz_table);
+    while (ip + LZ_MIN_MATCH <= n)
+    {
+        uint32_t v = lz_read32(src + ip);
+        unsigned h = lz_hash(v);
+        size_t ref = lz_table[h];
+        size_t len;
+
+        lz_table[h] = ip + 1;
+        if (ref == 0 || lz_read32(src + ref - 1) != v)
+        {
+            ip++;
+            continue;
+        }
+        ref--;
+        for (len = LZ_MIN_MATCH; ip + len < n && src[ref + len] == src[ip + len];
+             len++)
+            continue;
+        op = lz_put_seq(op, oend, src + anchor, ip - anchor, ip - ref, len);
+        if (op == NULL)
+            return 0;
+        ip += len;
+        anchor = ip;
+    }
+    if (anchor < n)
+    {
+        op = lz_put_seq(op, oend, src + anchor, n - anchor, 0, 0);
+        if (op == NULL)
+            return 0;
+    }
+    return op - dst;
+}
+
+/* Reads a nibble's continuation bytes from *IP, adding them to N. */
+static size_t lz_get_len(const uint8_t **ip, const uint8_t *iend, size_t n)
+{
+    uint8_t b = 0;
+
+    do
+    {
+        if (*ip >= iend)
+            break;
+        b = *(*ip)++;
+        n += b;
+    } while (b == 255);
+    return n;
+}
+
+/* Decompresses the N bytes at SRC into DST. Returns the decompressed
+ * length, which never exceeds DST_MAX. */
+static size_t lz_decompress(const uint8_t *src, size_t n, uint8_t *dst,
+                            size_t dst_max)
+{
+    const uint8_t *ip = src, *iend = src + n;
+    uint8_t *op = dst, *oend = dst + dst_max;
+
+    while (ip < iend)
+    {
+        uint8_t token = *ip++;
+        size_t lit_len = token >> 4, mlen = token & 15, dist;
+
+        if (lit_len == 15)
+            lit_len = lz_get_len(&ip, iend, lit_len);
+        if (lit_len > (size_t)(iend - ip) || lit_len > (size_t)(oend - op))
+            break;
+        memcpy(op, ip, lit_len);
+        ip += lit_len;
+        op += lit_len;
+        if (iend - ip < 2)
+            break;
+
+        dist = ip[0] | ip[1] << 8;
+        ip += 2;
+        if (mlen == 15)
+            mlen = lz_get_len(&ip, iend, mlen);
+        mlen += LZ_MIN_MATCH;
+        if (dist == 0 || dist > (size_t)(op - dst) ||
+            mlen > (size_t)(oend - op))
+            break;
+        /* Byte by byte: the match may overlap its own output. */
+        for (; mlen > 0; mlen--, op++)
+            *op = *(op - dist);
+    }
+    return op - dst;
+}